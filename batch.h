@@ -0,0 +1,278 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "solver.h"
+#include <dirent.h>
+
+/**
+ * Batch mode: solve every scenario of a directory or a manifest in one process, instead of one
+ * ./solution process per file. The batch starts one thread per worker, and scenarios are handed
+ * out to the workers from a shared counter. Each worker keeps its Scenario, SolveArena and output
+ * buffer across the scenarios it solves, so allocations stay warm. Threads aren't pooled though:
+ * a solve with more than one thread starts its own for its parallel stages, and a pipelined solve
+ * its parser and writer, every time. Each solution is written to its own file, and a
+ * per-scenario timing table goes to stdout in batch list order once the batch is done.
+ *
+ * A manifest has one scenario per line, "<scenario path> [<solution path>]", '#' lines and empty
+ * lines skipped. Scenarios without a solution path, and every scenario of a directory (its .txt and
+ * .bin files, by name), are written to <output dir>/<scenario name minus extension>.out. A batch
+ * where two scenarios would write the same solution file (x.txt and x.bin, or a/x.txt and b/x.txt
+ * without solution paths) is rejected before anything is solved.
+ *
+ * Typical use:
+ * 		./solution --batch test_cases --output solutions/
+ * 		./solution --batch nightly.manifest --threads 32
+ * */
+
+struct BatchEntry {
+	string scenario_path;
+	string solution_path;
+};
+
+struct BatchResult {
+	/**
+	 * How one scenario of a batch went, filled in by whichever worker solved it
+	 */
+	bool ok;
+	int num_users;
+	int num_sats;
+	int num_assigned;
+
+	// time to load and solve the scenario, and to format and write its solution
+	double solve_ms;
+	double write_ms;
+};
+
+static inline bool ends_with(const string& text, const string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static inline string default_solution_path(const string& scenario_path, const string& output_dir) {
+	/**
+	 * <output_dir>/<scenario file name minus its extension>.out
+	 * */
+	size_t name_start = scenario_path.rfind('/');
+	string name = name_start == string::npos ? scenario_path : scenario_path.substr(name_start + 1);
+	size_t dot = name.rfind('.');
+	if (dot != string::npos && dot > 0) {
+		name = name.substr(0, dot);
+	}
+	return output_dir + "/" + name + ".out";
+}
+
+static inline bool check_unique_solution_paths(const vector<BatchEntry>& entries) {
+	/**
+	 * False (after saying which scenarios) if two entries share a solution path, one would
+	 * silently overwrite the other's solution
+	 * */
+	vector<int> order(entries.size());
+	for (int entry_i = 0; entry_i < (int) entries.size(); entry_i ++) {
+		order[entry_i] = entry_i;
+	}
+	stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		return entries[a].solution_path < entries[b].solution_path;
+	});
+	for (int order_i = 1; order_i < (int) order.size(); order_i ++) {
+		const BatchEntry& first = entries[order[order_i - 1]];
+		const BatchEntry& second = entries[order[order_i]];
+		if (first.solution_path == second.solution_path) {
+			cout << "Scenarios \'" << first.scenario_path << "\' and \'" << second.scenario_path
+				 << "\' would both be written to \'" << first.solution_path << "\'" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline bool read_batch_list(const string& batch_path, const string& output_dir, vector<BatchEntry>& out_entries) {
+	/**
+	 * Fill out_entries from batch_path, a directory or a manifest (see above). Returns false
+	 * (after saying why) if it can't be read, a manifest line is bad or two scenarios share a
+	 * solution path.
+	 * */
+	struct stat batch_stat;
+	if (stat(batch_path.c_str(), &batch_stat) != 0) {
+		cout << "File \'" << batch_path << "\' does not exist" << endl;
+		return false;
+	}
+
+	if (S_ISDIR(batch_stat.st_mode)) {
+		DIR* dir = opendir(batch_path.c_str());
+		if (dir == nullptr) {
+			cout << "Couldn't open directory \'" << batch_path << "\'" << endl;
+			return false;
+		}
+		vector<string> names;
+		for (struct dirent* dir_entry = readdir(dir); dir_entry != nullptr; dir_entry = readdir(dir)) {
+			string name = dir_entry->d_name;
+			if (ends_with(name, ".txt") || ends_with(name, ".bin")) {
+				names.push_back(name);
+			}
+		}
+		closedir(dir);
+		sort(names.begin(), names.end());
+		for (const string& name : names) {
+			string scenario_path = batch_path + "/" + name;
+			out_entries.push_back({scenario_path, default_solution_path(scenario_path, output_dir)});
+		}
+		return check_unique_solution_paths(out_entries);
+	}
+
+	MappedFile manifest;
+	if (!map_file(batch_path, &manifest)) {
+		cout << "File \'" << batch_path << "\' does not exist" << endl;
+		return false;
+	}
+	string_view text(manifest.data, manifest.size);
+	bool ok = true;
+	size_t line_start = 0;
+	while (ok && line_start < text.size()) {
+		size_t line_end = text.find('\n', line_start);
+		if (line_end == string_view::npos) {
+			line_end = text.size();
+		}
+		string_view line = text.substr(line_start, line_end - line_start);
+		line_start = line_end + 1;
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		// up to 2 whitespace separated fields
+		vector<string> fields;
+		size_t field_start = line.find_first_not_of(" \t\r");
+		while (field_start != string_view::npos) {
+			size_t field_end = line.find_first_of(" \t\r", field_start);
+			fields.emplace_back(line.substr(field_start, field_end == string_view::npos ? string_view::npos : field_end - field_start));
+			field_start = field_end == string_view::npos ? string_view::npos : line.find_first_not_of(" \t\r", field_end);
+		}
+		if (fields.empty()) {
+			continue;
+		}
+		if (fields.size() > 2) {
+			cout << "Bad manifest line, expected \"<scenario> [<solution>]\": " << line << endl;
+			ok = false;
+			break;
+		}
+		out_entries.push_back({fields[0], fields.size() == 2 ? fields[1] : default_solution_path(fields[0], output_dir)});
+	}
+	unmap_file(manifest);
+	return ok && check_unique_solution_paths(out_entries);
+}
+
+template <typename Config>
+struct BatchWorker {
+	/**
+	 * One worker's scratch, reused for every scenario it solves
+	 */
+	Scenario scenario;
+	SolveArena<Config> arena;
+	string solution_text;
+};
+
+template <typename Config>
+static inline void solve_batch_config(const vector<BatchEntry>& entries, const SolveOptions& options, vector<BatchResult>& out_results) {
+	/**
+	 * Solve entries, out_results[i] for entries[i], on up to options.num_threads worker threads 
+	 * started for the batch. Scenarios are the unit of parallelism: with more scenarios than 
+	 * threads each is solved with one thread, otherwise each worker's solves get an even share of 
+	 * the threads and start that many themselves (see parallel_for_chunks), on top of the workers. 
+	 * */
+	int num_entries = (int) entries.size();
+	int num_workers = MAX(1, MIN(options.num_threads, num_entries));
+	SolveOptions worker_options = options;
+	worker_options.num_threads = MAX(1, options.num_threads / num_workers);
+
+	out_results.assign(num_entries, BatchResult{});
+	vector<BatchWorker<Config>> workers(num_workers);
+	atomic<int> next_entry(0);
+	parallel_for_chunks(num_workers, num_workers, [&](int worker_i) {
+		BatchWorker<Config>& worker = workers[worker_i];
+		for (int entry_i = next_entry++; entry_i < num_entries; entry_i = next_entry++) {
+			const BatchEntry& entry = entries[entry_i];
+			BatchResult& result = out_results[entry_i];
+			auto start = chrono::steady_clock::now();
+			bool solved = false;
+			if (worker_options.pipeline && worker_options.stream_chunk_users == 0) {
+				// writes as it solves, so write_ms stays 0
+				solved = solve_scenario_pipelined(entry.scenario_path, entry.solution_path, worker_options, worker.scenario, worker.arena);
+				result.ok = solved;
+			} else {
+				solved = worker_options.stream_chunk_users > 0
+					? solve_scenario_streaming(entry.scenario_path, worker_options, worker.scenario, worker.arena)
+					: solve_scenario(entry.scenario_path, worker_options, worker.scenario, worker.arena);
+			}
+			auto solved_at = chrono::steady_clock::now();
+			if (solved && !result.ok) {
+				format_assignments(worker.arena.assignments, worker.solution_text);
+				result.ok = write_solution(worker.solution_text, entry.solution_path);
+			}
+			auto written_at = chrono::steady_clock::now();
+
+			// a streamed scenario never holds all of its users at once, so there's no count to report
+			result.num_users = solved && worker_options.stream_chunk_users == 0 ? num_positions(worker.scenario.users) : -1;
+			result.num_sats = num_positions(worker.scenario.sats);
+			result.num_assigned = (int) worker.arena.assignments.size();
+			result.solve_ms = chrono::duration<double, milli>(solved_at - start).count();
+			result.write_ms = chrono::duration<double, milli>(written_at - solved_at).count();
+		}
+	});
+}
+
+static inline int solve_batch(const string& batch_path, const SolveOptions& options) {
+	/**
+	 * Solve every scenario batch_path lists with the config options.config, writing solutions
+	 * under options.output_path (a directory in batch mode, "." if empty), then print the timing
+	 * table. Returns 0, or -1 if any scenario failed.
+	 * */
+	string output_dir = options.output_path == "" ? "." : options.output_path;
+	vector<BatchEntry> entries;
+	if (!read_batch_list(batch_path, output_dir, entries)) {
+		return -1;
+	}
+	if (mkdir(output_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+		cout << "Couldn't create output directory \'" << output_dir << "\': " << strerror(errno) << endl;
+		return -1;
+	}
+
+	vector<BatchResult> results;
+	auto start = chrono::steady_clock::now();
+	bool found = with_solver_config(options.config, [&](auto config) {
+		solve_batch_config<decltype(config)>(entries, options, results);
+	});
+	if (!found) {
+		cout << "Unknown config \'" << options.config << "\', expected one of " << solver_config_names() << endl;
+		return -1;
+	}
+	double total_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	int num_failed = 0;
+	printf("%-48s %10s %7s %8s %12s %12s %s\n", "scenario", "users", "sats", "beams", "solve_ms", "write_ms", "solution");
+	for (int entry_i = 0; entry_i < (int) entries.size(); entry_i ++) {
+		const BatchEntry& entry = entries[entry_i];
+		const BatchResult& result = results[entry_i];
+		if (!result.ok) {
+			printf("%-48s FAILED\n", entry.scenario_path.c_str());
+			num_failed ++;
+			continue;
+		}
+		char users[16] = "-";
+		if (result.num_users >= 0) {
+			snprintf(users, sizeof(users), "%d", result.num_users);
+		}
+		printf("%-48s %10s %7d %8d %12.3f %12.3f %s\n", entry.scenario_path.c_str(), users, result.num_sats,
+			   result.num_assigned, result.solve_ms, result.write_ms, entry.solution_path.c_str());
+	}
+	printf("%d scenarios, %d failed, %.3f ms\n", (int) entries.size(), num_failed, total_ms);
+	fflush(stdout);
+
+#ifdef PROFILE
+	if (options.profile_json_path != "") {
+		write_solution(profile_summary_json(), options.profile_json_path);
+	} else {
+		print_profile_summary();
+	}
+#endif
+	return num_failed == 0 ? 0 : -1;
+}
+
+#endif // BATCH_H
@@ -0,0 +1,412 @@
+#include "solver.h"
+#include "synthetic.h"
+#include <chrono>
+#include <climits>
+
+/**
+ * Stage-level benchmark for the solver. Times each stage of solve_scenario separately,
+ * over the given scenario files and over synthetic constellations, and writes the results
+ * as JSON.
+ *
+ * Every case is loaded into memory before it runs, so "parse" times load_scenario over
+ * in-memory text (or binary scenarios, see convert_scenario) and excludes file I/O. Synthetic
+ * cases (see synthetic.h) are generated just before they run and dropped after, so only one is
+ * ever held at a time.
+ *
+ * --sweep-users and --sweep-sats add a scaling sweep: one synthetic case per users x sats pair,
+ * with a near-square Walker shell of at least that many sats. With --sweep-budget-ms a sats
+ * count's larger user counts are skipped once one of its cases takes longer than the budget, so
+ * a sweep stops where the solver stops scaling instead of running for hours. Each stage's JSON
+ * also records its throughput, users per second at the median time.
+ *
+ * Typical use:
+ * 		./solution_bench --max-synthetic-users 0 --reps 1 --sweep-users 10000,100000,1000000
+ * 			--sweep-sats 1000,10000,40000 --sweep-budget-ms 60000 --json bench_scaling.json
+ * */
+
+using bench_clock = chrono::steady_clock;
+
+enum BenchStage {
+	STAGE_PARSE,
+	STAGE_GRID,
+	STAGE_VISIBILITY,
+	STAGE_SORT,
+	STAGE_ASSIGN,
+	STAGE_FORMAT,
+	NUM_STAGES
+};
+static const char* STAGE_NAMES[NUM_STAGES] = {"parse", "grid", "visibility", "sort", "assign", "format"};
+
+struct BenchCase {
+	string name;
+	// scenario in either format load_scenario reads, empty for a synthetic case until it runs
+	string text;
+
+	bool synthetic;
+	WalkerParams params;
+
+	// the --sweep-sats count a sweep case was made for, 0 outside the sweep
+	int sweep_sats;
+};
+
+struct BenchResult {
+	string name;
+	int num_users;
+	int num_sats;
+	int num_interferers;
+	int num_assigned;
+
+	// time of each rep, per stage, in ms
+	vector<double> stage_ms[NUM_STAGES];
+};
+
+struct BenchOptions {
+	SolveOptions solve_options;
+	int reps;
+	int max_synthetic_users;
+	vector<int> sweep_users;
+	vector<int> sweep_sats;
+	double sweep_budget_ms;
+	string json_path;
+	vector<string> scenario_paths;
+};
+
+static bool parse_count_list(const string& text, vector<int>& out_counts) {
+	/**
+	 * Comma separated positive counts, ascending in out_counts. Returns false if one isn't a count.
+	 * */
+	out_counts.clear();
+	size_t start = 0;
+	while (start <= text.size()) {
+		size_t end = text.find(',', start);
+		if (end == string::npos) {
+			end = text.size();
+		}
+		string field = text.substr(start, end - start);
+		char* field_end = nullptr;
+		long count = strtol(field.c_str(), &field_end, 10);
+		if (field.empty() || *field_end != '\0' || count <= 0 || count > INT_MAX) {
+			return false;
+		}
+		out_counts.push_back((int) count);
+		start = end + 1;
+	}
+	sort(out_counts.begin(), out_counts.end());
+	return true;
+}
+
+static BenchCase sweep_case(int num_users, int num_sats) {
+	/**
+	 * The default Walker shell and users (see default_walker_params) reshaped to at least
+	 * num_sats sats, in a near-square planes x sats per plane grid
+	 * */
+	WalkerParams params = default_walker_params();
+	params.num_users = num_users;
+	params.num_planes = (int) ceil(sqrt((double) num_sats));
+	params.sats_per_plane = (num_sats + params.num_planes - 1) / params.num_planes;
+	string name = "sweep_walker_" + to_string(params.num_planes) + "x" + to_string(params.sats_per_plane)
+		+ "_" + to_string(num_users) + "_users";
+	return {name, "", true, params, num_sats};
+}
+
+static inline double elapsed_ms(bench_clock::time_point start) {
+	return chrono::duration<double, milli>(bench_clock::now() - start).count();
+}
+
+template <typename Config>
+static bool run_case(const BenchCase& bench_case, const BenchOptions& options, BenchResult& result) {
+	/**
+	 * Run bench_case options.reps times through the solver's stages, recording each stage's time
+	 * */
+	result = {};
+	result.name = bench_case.name;
+	SolveArena<Config> arena = {};
+	string solution_text = "";
+
+	for (int rep = 0; rep < options.reps; rep ++) {
+		Scenario scenario = {};
+		reset_arena(arena);
+
+		// bench_case outlives the scenario, so a binary case is viewed in place like solve_scenario's
+		shared_ptr<const void> backing(bench_case.text.data(), [](const void*) {});
+		bench_clock::time_point start = bench_clock::now();
+		if (!load_scenario(bench_case.text.data(), bench_case.text.size(), scenario, arena.sat_beam_list, backing)) {
+			return false;
+		}
+		result.stage_ms[STAGE_PARSE].push_back(elapsed_ms(start));
+
+		start = bench_clock::now();
+		SatGrid sat_grid = build_sat_grid(scenario, arena.sat_beam_list);
+		result.stage_ms[STAGE_GRID].push_back(elapsed_ms(start));
+
+		start = bench_clock::now();
+		generate_user_vis_list(scenario, sat_grid, options.solve_options, arena);
+		choose_visibility_format(options.solve_options, arena);
+		result.stage_ms[STAGE_VISIBILITY].push_back(elapsed_ms(start));
+
+		start = bench_clock::now();
+		sort_user_vis_list(arena);
+		result.stage_ms[STAGE_SORT].push_back(elapsed_ms(start));
+
+		start = bench_clock::now();
+		find_assign_strategy<Config>(options.solve_options.assign_strategy)->assign(scenario, options.solve_options, arena);
+		result.stage_ms[STAGE_ASSIGN].push_back(elapsed_ms(start));
+
+		start = bench_clock::now();
+		format_assignments(arena.assignments, solution_text);
+		result.stage_ms[STAGE_FORMAT].push_back(elapsed_ms(start));
+
+		result.num_users = num_positions(scenario.users);
+		result.num_sats = num_positions(scenario.sats);
+		result.num_interferers = num_positions(scenario.interferers);
+		result.num_assigned = (int) arena.assignments.size();
+	}
+	return true;
+}
+
+static inline double min_of(const vector<double>& values) {
+	return *min_element(values.begin(), values.end());
+}
+
+static inline double median_of(vector<double> values) {
+	sort(values.begin(), values.end());
+	size_t mid = values.size() / 2;
+	return values.size() % 2 == 1 ? values[mid] : (values[mid - 1] + values[mid]) / 2.0;
+}
+
+static inline double mean_of(const vector<double>& values) {
+	double total = 0;
+	for (double value : values) {
+		total += value;
+	}
+	return total / values.size();
+}
+
+static string json_escape(const string& text) {
+	string out = "";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+		}
+		out += c;
+	}
+	return out;
+}
+
+static inline double users_per_s(int num_users, double ms) {
+	return ms > 0 ? num_users / (ms / 1000.0) : 0.0;
+}
+
+static string results_json(const vector<BenchResult>& results, const BenchOptions& options) {
+	/**
+	 * Results as JSON: one object per case, with min / median / mean ms and users per second at
+	 * the median for each stage
+	 * */
+	char buff[512];
+	string json = "{\n";
+	snprintf(buff, sizeof(buff), "  \"threads\": %d,\n  \"reps\": %d,\n  \"assign_strategy\": \"%s\",\n  \"assign_budget_ms\": %.3f,\n  \"candidate_order\": \"%s\",\n  \"vis_order\": \"%s\",\n  \"vis_format\": \"%s\",\n  \"vis_backend\": \"%s\",\n  \"config\": \"%s\",\n  \"cases\": [\n",
+			 options.solve_options.num_threads, options.reps, options.solve_options.assign_strategy.c_str(), 
+			 options.solve_options.assign_budget_ms, options.solve_options.candidate_order.c_str(), 
+			 options.solve_options.vis_order.c_str(), options.solve_options.vis_format.c_str(), options.solve_options.vis_backend.c_str(), options.solve_options.config.c_str());
+	json += buff;
+	for (size_t case_i = 0; case_i < results.size(); case_i ++) {
+		const BenchResult& result = results[case_i];
+		json += "    {\"name\": \"" + json_escape(result.name) + "\", ";
+		snprintf(buff, sizeof(buff), "\"users\": %d, \"sats\": %d, \"interferers\": %d, \"assigned\": %d, \"stages_ms\": {",
+				 result.num_users, result.num_sats, result.num_interferers, result.num_assigned);
+		json += buff;
+
+		vector<double> total_ms(options.reps, 0.0);
+		for (int stage = 0; stage < NUM_STAGES; stage ++) {
+			const vector<double>& times = result.stage_ms[stage];
+			for (int rep = 0; rep < options.reps; rep ++) {
+				total_ms[rep] += times[rep];
+			}
+			snprintf(buff, sizeof(buff), "\"%s\": {\"min\": %.4f, \"median\": %.4f, \"mean\": %.4f, \"users_per_s\": %.1f}, ",
+					 STAGE_NAMES[stage], min_of(times), median_of(times), mean_of(times),
+					 users_per_s(result.num_users, median_of(times)));
+			json += buff;
+		}
+		snprintf(buff, sizeof(buff), "\"total\": {\"min\": %.4f, \"median\": %.4f, \"mean\": %.4f, \"users_per_s\": %.1f}}}",
+				 min_of(total_ms), median_of(total_ms), mean_of(total_ms), users_per_s(result.num_users, median_of(total_ms)));
+		json += buff;
+		json += case_i + 1 < results.size() ? ",\n" : "\n";
+	}
+	json += "  ]\n}\n";
+	return json;
+}
+
+static void print_result(const BenchResult& result) {
+	/**
+	 * One line per case of median stage times
+	 * */
+	printf("%-46s %8d %6d", result.name.c_str(), result.num_users, result.num_sats);
+	double total = 0;
+	for (int stage = 0; stage < NUM_STAGES; stage ++) {
+		double median = median_of(result.stage_ms[stage]);
+		total += median;
+		printf(" %10.3f", median);
+	}
+	printf(" %10.3f %8d\n", total, result.num_assigned);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options = {};
+	options.solve_options = default_solve_options();
+	options.reps = 3;
+	options.max_synthetic_users = 1000000;
+	options.sweep_budget_ms = 0;
+	options.json_path = "bench_results.json";
+
+	for (int i = 1; i < argc; i ++) {
+		string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			int num_threads = atoi(argv[++ i]);
+			options.solve_options.num_threads = MAX(1, num_threads);
+		} else if (arg == "--reps" && i + 1 < argc) {
+			int reps = atoi(argv[++ i]);
+			options.reps = MAX(1, reps);
+		} else if (arg == "--max-synthetic-users" && i + 1 < argc) {
+			options.max_synthetic_users = atoi(argv[++ i]);
+		} else if ((arg == "--sweep-users" || arg == "--sweep-sats") && i + 1 < argc) {
+			string list = argv[++ i];
+			if (!parse_count_list(list, arg == "--sweep-users" ? options.sweep_users : options.sweep_sats)) {
+				cout << "Bad " << arg << " \'" << list << "\', expected comma separated counts" << endl;
+				return 1;
+			}
+		} else if (arg == "--sweep-budget-ms" && i + 1 < argc) {
+			options.sweep_budget_ms = atof(argv[++ i]);
+		} else if (arg == "--no-simd") {
+			options.solve_options.use_simd = false;
+		} else if (arg == "--assign" && i + 1 < argc) {
+			options.solve_options.assign_strategy = argv[++ i];
+		} else if (arg == "--assign-budget-ms" && i + 1 < argc) {
+			options.solve_options.assign_budget_ms = atof(argv[++ i]);
+		} else if (arg == "--candidate-order" && i + 1 < argc) {
+			options.solve_options.candidate_order = argv[++ i];
+		} else if (arg == "--vis-format" && i + 1 < argc) {
+			options.solve_options.vis_format = argv[++ i];
+		} else if (arg == "--vis-backend" && i + 1 < argc) {
+			options.solve_options.vis_backend = argv[++ i];
+		} else if (arg == "--vis-order" && i + 1 < argc) {
+			options.solve_options.vis_order = argv[++ i];
+		} else if (arg == "--config" && i + 1 < argc) {
+			options.solve_options.config = argv[++ i];
+		} else if (arg == "--json" && i + 1 < argc) {
+			options.json_path = argv[++ i];
+		} else if (arg.rfind("--", 0) != 0) {
+			options.scenario_paths.push_back(arg);
+		} else {
+			cout << "Expected arguments: [--threads N] [--reps N] [--max-synthetic-users N] [--sweep-users N,N,...] [--sweep-sats N,N,...] [--sweep-budget-ms MS] [--no-simd] [--assign " << assign_strategy_names() 
+				 << "] [--assign-budget-ms MS] [--candidate-order " << candidate_order_names() << "] [--vis-order " VIS_ORDER_NAMES "] [--vis-format " VIS_FORMAT_NAMES "] [--vis-backend " VIS_BACKEND_NAMES "] [--config " << solver_config_names() 
+				 << "] [--json /path/to/results.json] [/path/to/scenario.txt ...]" << endl;
+			return 0;
+		}
+	}
+	if (find_assign_strategy<StarlinkConfig>(options.solve_options.assign_strategy) == nullptr) {
+		cout << "Unknown assignment strategy \'" << options.solve_options.assign_strategy << "\', expected one of " 
+			 << assign_strategy_names() << endl;
+		return 1;
+	}
+	CandidateOrder candidate_order;
+	if (!find_candidate_order(options.solve_options.candidate_order, &candidate_order)) {
+		cout << "Unknown candidate order \'" << options.solve_options.candidate_order << "\', expected one of " 
+			 << candidate_order_names() << endl;
+		return 1;
+	}
+	if (!is_vis_order(options.solve_options.vis_order)) {
+		cout << "Unknown visibility order \'" << options.solve_options.vis_order << "\', expected one of " VIS_ORDER_NAMES << endl;
+		return 1;
+	}
+	if (!is_vis_backend(options.solve_options.vis_backend)) {
+		cout << "Unknown visibility backend \'" << options.solve_options.vis_backend << "\', expected one of " VIS_BACKEND_NAMES << endl;
+		return 1;
+	}
+	if (!is_vis_format(options.solve_options.vis_format)) {
+		cout << "Unknown visibility format \'" << options.solve_options.vis_format << "\', expected one of " VIS_FORMAT_NAMES << endl;
+		return 1;
+	}
+	if (!with_solver_config(options.solve_options.config, [](auto) {})) {
+		cout << "Unknown config \'" << options.solve_options.config << "\', expected one of " 
+			 << solver_config_names() << endl;
+		return 1;
+	}
+
+	vector<BenchCase> cases = {};
+	for (const string& path : options.scenario_paths) {
+		MappedFile file;
+		if (!map_file(path, &file)) {
+			cout << "File \'" << path << "\' does not exist" << endl;
+			return 1;
+		}
+		cases.push_back({path, string(file.data, file.size), false, {}, 0});
+		unmap_file(file);
+	}
+
+	// 72 x 20 shell, like 11_one_hundred_thousand_users, scaled up in users
+	for (int num_users = 10000; num_users <= options.max_synthetic_users; num_users *= 10) {
+		WalkerParams params = default_walker_params();
+		params.num_users = num_users;
+		cases.push_back({"synthetic_walker_72x20_" + to_string(num_users) + "_users", "", true, params, 0});
+	}
+
+	// sats outer, users inner, so the budget cuts each sats count's sweep off at its largest users
+	if (options.sweep_users.empty() != options.sweep_sats.empty()) {
+		cout << "--sweep-users and --sweep-sats go together" << endl;
+		return 1;
+	}
+	for (int num_sats : options.sweep_sats) {
+		for (int num_users : options.sweep_users) {
+			cases.push_back(sweep_case(num_users, num_sats));
+		}
+	}
+
+	printf("%-46s %8s %6s", "case (median ms)", "users", "sats");
+	for (int stage = 0; stage < NUM_STAGES; stage ++) {
+		printf(" %10s", STAGE_NAMES[stage]);
+	}
+	printf(" %10s %8s\n", "total", "assigned");
+
+	vector<BenchResult> results = {};
+	vector<int> over_budget_sats = {};
+	for (BenchCase& bench_case : cases) {
+		if (bench_case.sweep_sats > 0 && find(over_budget_sats.begin(), over_budget_sats.end(), bench_case.sweep_sats) != over_budget_sats.end()) {
+			printf("%-46s skipped, over --sweep-budget-ms\n", bench_case.name.c_str());
+			continue;
+		}
+		if (bench_case.synthetic) {
+			bench_case.text = walker_scenario_text(bench_case.params);
+		}
+
+		BenchResult result;
+		bool ran = false;
+		with_solver_config(options.solve_options.config, [&](auto config) {
+			ran = run_case<decltype(config)>(bench_case, options, result);
+		});
+		if (!ran) {
+			cout << "Couldn't parse " << bench_case.name << endl;
+			return 1;
+		}
+		if (bench_case.synthetic) {
+			string().swap(bench_case.text);
+		}
+		print_result(result);
+		results.push_back(result);
+
+		double total_ms = 0;
+		for (int stage = 0; stage < NUM_STAGES; stage ++) {
+			total_ms += median_of(result.stage_ms[stage]);
+		}
+		if (bench_case.sweep_sats > 0 && options.sweep_budget_ms > 0 && total_ms > options.sweep_budget_ms) {
+			over_budget_sats.push_back(bench_case.sweep_sats);
+		}
+	}
+
+	if (!write_solution(results_json(results, options), options.json_path)) {
+		return 1;
+	}
+	printf("wrote %s\n", options.json_path.c_str());
+	return 0;
+}
@@ -0,0 +1,45 @@
+#include "solver.h"
+
+/**
+ * Converts a text scenario ("sat 1 6921 0 0" lines) to the binary format solve() also reads, 
+ * see BinaryScenarioHeader. Binary files can be passed anywhere a scenario file is expected. 
+ * */
+
+int main(int argc, char** argv)
+{
+	if (argc != 3) {
+		cout << "Expected arguments: /path/to/scenario.txt /path/to/scenario.bin" << endl;
+		return 0;
+	}
+	string in_path = argv[1];
+	string out_path = argv[2];
+
+	MappedFile scenario_file;
+	if (!map_file(in_path, &scenario_file)) {
+		cout << "File \'" << in_path << "\' does not exist" << endl;
+		return 1;
+	}
+	Scenario scenario = {};
+	vector<SatBeamEntry<StarlinkConfig>> sat_beam_list = {};
+	bool parsed = load_scenario(scenario_file.data, scenario_file.size, scenario, sat_beam_list);
+	unmap_file(scenario_file);
+	if (!parsed) {
+		return 1;
+	}
+
+	// the binary format has no ids, sat i is always id i + 1
+	for (int slot = 0; slot < (int) sat_beam_list.size(); slot ++) {
+		if (sat_beam_list[slot].sat_id != slot) {
+			cout << "sat ids must be 1..N in file order, sat " << slot + 1 << " has id " 
+				 << sat_beam_list[slot].sat_id + 1 << endl;
+			return 1;
+		}
+	}
+
+	string data = "";
+	format_binary_scenario(scenario, data);
+	if (!write_solution(data, out_path)) {
+		return 1;
+	}
+	return 0;
+}
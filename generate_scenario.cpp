@@ -0,0 +1,84 @@
+#include "solver.h"
+#include "synthetic.h"
+
+/**
+ * Writes a synthetic text scenario: a Walker delta shell, users over latitude bands and GEO belt
+ * interferers, see synthetic.h. Unset options keep default_walker_params. The file is written as
+ * it's generated, so 10M user scenarios don't need to fit in memory; convert_scenario turns it
+ * into a binary one.
+ *
+ * Typical use:
+ * 		./generate_scenario --planes 200 --sats-per-plane 200 --users 10000000 big.txt
+ * 		./generate_scenario --users 100000 --user-band 25:50:4 --user-band -60:60:1 -
+ * */
+
+// generated text is written out in blocks of about this many bytes
+#define GENERATE_WRITE_BYTES (1 << 20)
+
+int main(int argc, char** argv)
+{
+	WalkerParams params = default_walker_params();
+	bool default_bands = true;
+	string out_path = "";
+	bool args_ok = true;
+	for (int i = 1; i < argc; i ++) {
+		string arg = argv[i];
+		if (arg == "--planes" && i + 1 < argc) {
+			params.num_planes = atoi(argv[++ i]);
+		} else if (arg == "--sats-per-plane" && i + 1 < argc) {
+			params.sats_per_plane = atoi(argv[++ i]);
+		} else if (arg == "--phasing" && i + 1 < argc) {
+			params.phasing = atoi(argv[++ i]);
+		} else if (arg == "--inclination" && i + 1 < argc) {
+			params.inclination_deg = atof(argv[++ i]);
+		} else if (arg == "--altitude" && i + 1 < argc) {
+			params.altitude_km = atof(argv[++ i]);
+		} else if (arg == "--users" && i + 1 < argc) {
+			params.num_users = atoi(argv[++ i]);
+		} else if (arg == "--user-band" && i + 1 < argc) {
+			// the first band given replaces the default one
+			LatitudeBand band;
+			string band_text = argv[++ i];
+			if (!parse_latitude_band(band_text, &band)) {
+				cout << "Bad --user-band \'" << band_text << "\', expected MIN:MAX[:WEIGHT] degrees" << endl;
+				return 1;
+			}
+			if (default_bands) {
+				params.user_bands.clear();
+				default_bands = false;
+			}
+			params.user_bands.push_back(band);
+		} else if (arg == "--interferers" && i + 1 < argc) {
+			params.num_interferers = atoi(argv[++ i]);
+		} else if (arg == "--seed" && i + 1 < argc) {
+			params.seed = (unsigned) strtoul(argv[++ i], nullptr, 10);
+		} else if (arg.rfind("--", 0) != 0 && out_path == "") {
+			out_path = arg;
+		} else {
+			args_ok = false;
+		}
+	}
+	if (!args_ok || out_path == "" || params.num_planes <= 0 || params.sats_per_plane <= 0 || params.num_users < 0
+		|| params.num_interferers < 0) {
+		cout << "Expected arguments: [--planes N] [--sats-per-plane N] [--phasing F] [--inclination DEG] [--altitude KM] "
+			 << "[--users N] [--user-band MIN:MAX[:WEIGHT] ...] [--interferers N] [--seed S] /path/to/scenario.txt (- for stdout)" << endl;
+		return 0;
+	}
+
+	int fd = open_solution_output(out_path == "-" ? "" : out_path);
+	if (fd < 0) {
+		return 1;
+	}
+	string text = walker_scenario_header(params);
+	text.reserve(GENERATE_WRITE_BYTES + MAX_OBJECT_LINE_LEN);
+	bool write_ok = true;
+	generate_walker_scenario(params, [&](const char* type, int id, double x, double y, double z) {
+		append_object_line(text, type, id, x, y, z);
+		if (text.size() >= GENERATE_WRITE_BYTES) {
+			write_ok = write_all(fd, text.data(), text.size()) && write_ok;
+			text.clear();
+		}
+	});
+	write_ok = write_all(fd, text.data(), text.size()) && write_ok;
+	return close_solution_output(fd, write_ok) ? 0 : 1;
+}
@@ -0,0 +1,672 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "solver.h"
+#include <queue>
+
+/**
+ * Incremental re-planning for a constellation that keeps moving. A Planner holds a solved
+ * scenario and its beams between calls; update_sat_positions / add_user / remove_user record
+ * changes, and replan brings the plan back in line with them.
+ *
+ * Each user remembers a slack: how far any sat has to move before one of the user's visibility
+ * or interferer decisions could flip. replan only recomputes visibility for users whose slack
+ * the constellation's accumulated motion has used up, mostly by re-checking the few sats in the
+ * user's skin rather than querying the sat grid again, keeps every beam that's still valid, and
+ * only runs the greedy for users that lost their beam or gained a reason to retry.
+ *
+ * Nothing in replan scans every user. New users and users that lost a beam are queued, users come
+ * due for evaluation off a heap ordered by when their slack runs out, and an unassigned user is
+ * listed on each sat it sees, so a sat that frees a beam finds the users to retry. Removed users'
+ * ids are reused by add_user, so the users don't grow past the most ever active at once. Besides
+ * the users it touches, a tick only costs a pass over the sats if they moved.
+ *
+ * Typical use:
+ * 		Planner planner;
+ * 		init_planner(planner, scenario, options);
+ * 		// every tick
+ * 		update_sat_positions(planner, sat_positions);
+ * 		replan(planner);
+ * 		planner_assignments(planner, assignments);
+ * */
+
+// the planner only runs evaluate.py's constellation config, see SolverConfig
+using PlannerConfig = StarlinkConfig;
+
+// each user keeps the sats up to this far past max_user_visible_angle, so a sat can't sneak into the
+// user's view without the user's slack covering it (the skin of a Verlet list). The list is rebuilt
+// from the sat grid once over PLANNER_SKIN_REBUILD_FRACTION of that headroom is used up
+#define PLANNER_SKIN_DEG 10.0
+#define PLANNER_SKIN_REBUILD_FRACTION 0.5
+
+// angular margins are shrunk by this much before they become slack, for float error in computing them
+#define PLANNER_MARGIN_EPS_DEG 1e-3
+
+struct PlannerUser {
+	/**
+	 * A user's state between replans
+	 */
+	// a removed user's slot stays in the scenario, ignored, until add_user reuses its id
+	bool active;
+
+	// visibility has to be recomputed, and the user (re)tried for a beam, on the next replan. Each 
+	// is set while the user is in Planner::eval_queue / Planner::assign_queue, see queue_eval
+	bool needs_eval;
+	bool needs_assign;
+
+	// bumped whenever visible_sats is recomputed or the id changes hands, so Planner::slack_heap 
+	// and Planner::sat_waiting entries made before then can be told apart and dropped
+	uint32_t stamp;
+
+	// listed in Planner::sat_waiting under each of visible_sats for this stamp
+	bool waiting;
+
+	// in replan's pending list
+	bool pending;
+
+	// sats the user could connect to, ascending, same as append_visible_sats would give
+	vector<sat_id_t> visible_sats;
+
+	// visible_sats stays exact until Planner::motion_total passes motion_at_eval + slack
+	double slack;
+	double motion_at_eval;
+
+	// every sat within PLANNER_SKIN_DEG of visible, ascending, while Planner::motion_total is 
+	// under motion_at_skin + skin_slack
+	vector<sat_id_t> skin_sats;
+	double skin_slack;
+	double motion_at_skin;
+
+	// the user's beam, sat_id = -1 if unassigned. beam_slot is the bit in the sat's color_beams
+	sat_id_t sat_id;
+	uint8_t beam_slot;
+	uint8_t color_i;
+};
+
+struct PlannerSlackDeadline {
+	/**
+	 * Planner::motion_total at which user_id's slack from its evaluation at stamp runs out
+	 */
+	double motion_total;
+	user_id_t user_id;
+	uint32_t stamp;
+
+	bool operator>(const PlannerSlackDeadline& other) const {
+		return motion_total > other.motion_total;
+	}
+};
+
+struct PlannerWaiter {
+	/**
+	 * An unassigned user listed under a sat it sees, while the user is still at stamp
+	 */
+	user_id_t user_id;
+	uint32_t stamp;
+};
+
+struct Planner {
+	/**
+	 * Persistent state for incremental solving, see init_planner
+	 */
+	Scenario scenario;
+	SolveOptions options;
+
+	// one entry per sat like SolveArena::sat_beam_list, except beams can be freed, so a sat's beams
+	// are the set bits of its color_beams rather than the first total_sat_beam_count slots
+	vector<SatBeamEntry<PlannerConfig>> sat_beam_list;
+
+	// user of each beam, beam_users[sat_id * PlannerConfig::beams_per_satellite + slot], -1 if free
+	vector<user_id_t> beam_users;
+
+	vector<PlannerUser> users;
+
+	// ids of removed users, for add_user to reuse
+	vector<user_id_t> free_user_ids;
+
+	// users with needs_eval / needs_assign set, in the order they were queued
+	vector<user_id_t> eval_queue;
+	vector<user_id_t> assign_queue;
+
+	// one entry per evaluation, soonest deadline on top. Entries whose stamp is out of date are 
+	// dropped as they come up
+	priority_queue<PlannerSlackDeadline, vector<PlannerSlackDeadline>, greater<PlannerSlackDeadline>> slack_heap;
+
+	// per sat, unassigned users that see it. Entries of users that since got a beam or were 
+	// re-evaluated are dropped when the sat frees a beam, or once the list doubles in size
+	vector<vector<PlannerWaiter>> sat_waiting;
+	vector<int> sat_waiting_compacted;
+
+	// rebuilt on the first replan that needs it after sats move
+	SatGrid sat_grid;
+	bool sat_grid_stale;
+
+	// sum over all update_sat_positions calls of the furthest any sat moved, which bounds how far
+	// every sat has moved between any two calls
+	double motion_total;
+
+	// smallest sat distance from ORIGIN, for bounding the distance to sats users don't track
+	float min_sat_mag;
+
+	// per sat flags for the next replan: it moved / one of its beams was freed, and the sats 
+	// with sat_freed set
+	vector<uint8_t> sat_moved;
+	vector<uint8_t> sat_freed;
+	vector<sat_id_t> freed_sats;
+};
+
+static inline float min_sat_mag_of(const Scenario& scenario) {
+	float min_mag = INFINITY;
+	for (float mag : scenario.sats.mags) {
+		min_mag = MIN(min_mag, mag);
+	}
+	return min_mag;
+}
+
+static inline double range_at_zenith(double user_mag, double sat_mag, double zenith_deg) {
+	/**
+	 * Distance from a user user_mag from ORIGIN to a sat sat_mag from ORIGIN that's zenith_deg from
+	 * the user's zenith. With r that distance, sat_mag^2 = user_mag^2 + r^2 + 2 user_mag r cos(zenith),
+	 * and r only grows with zenith, so it's also the closest any sat at least zenith_deg out can be.
+	 * */
+	double cos_zenith = cos(DEG_TO_RAD(zenith_deg));
+	double disc = user_mag * user_mag * cos_zenith * cos_zenith + sat_mag * sat_mag - user_mag * user_mag;
+	return MAX(0.0, -user_mag * cos_zenith + sqrt(MAX(0.0, disc)));
+}
+
+static inline double interferer_margin_deg(const InterfererCones& cones, vector_3d_t user_pos, vector_3d_t sat_pos) {
+	/**
+	 * Smallest difference between PlannerConfig::non_starlink_interference_max and the angle from sat_pos to one of
+	 * cones' interferers, as seen from the user.
+	 *
+	 * Interferers left out of cones are over PlannerConfig::max_user_visible_angle + PlannerConfig::non_starlink_interference_max + 0.5
+	 * from the zenith, so for a visible sat their margin is more than its visibility margin.
+	 * */
+	float w[3] = {sat_pos[0] - user_pos[0], sat_pos[1] - user_pos[1], sat_pos[2] - user_pos[2]};
+	float w_mag = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+	if (w_mag == 0) {
+		return 0;
+	}
+	double margin_deg = 180.0;
+	for (int cone_i = 0; cone_i < (int) cones.cos_zeniths.size(); cone_i ++) {
+		double cos_angle = (w[0] * cones.xs[cone_i] + w[1] * cones.ys[cone_i] + w[2] * cones.zs[cone_i]) / w_mag;
+		double angle = RAD_TO_DEG(acos(MAX(-1.0, MIN(1.0, cos_angle))));
+		margin_deg = MIN(margin_deg, fabs(angle - PlannerConfig::non_starlink_interference_max));
+	}
+	return margin_deg;
+}
+
+static inline void evaluate_planner_user(const Planner& planner, user_id_t user_i, VisScratch& scratch, PlannerUser& user) {
+	/**
+	 * Recompute user.visible_sats (same decisions as append_visible_sats) and user.slack, rebuilding 
+	 * user.skin_sats first if it's new or used up. 
+	 *
+	 * A sat moving distance d changes its direction from the user by at most asin(d / r), r the
+	 * distance between them, so a decision with an angular margin m to its constraint holds until
+	 * the sat has moved r sin(m). Sats outside the PLANNER_SKIN_DEG skin all have a margin of at
+	 * least PLANNER_SKIN_DEG and are at least range_at_zenith away.
+	 * */
+	const Scenario& scenario = planner.scenario;
+	vector_3d_t user_pos = position_at(scenario.users, user_i);
+	if (user.needs_eval || planner.motion_total - user.motion_at_skin >= PLANNER_SKIN_REBUILD_FRACTION * user.skin_slack) {
+		gather_candidate_slots(planner.sat_grid, user_pos, PlannerConfig::max_user_visible_angle + PLANNER_SKIN_DEG, scratch);
+		user.skin_sats.clear();
+		for (int slot : scratch.candidate_slots) {
+			user.skin_sats.push_back(planner.sat_beam_list[slot].sat_id);
+		}
+		double skin_range = range_at_zenith(scenario.users.mags[user_i], planner.min_sat_mag, PlannerConfig::max_user_visible_angle + PLANNER_SKIN_DEG);
+		user.skin_slack = skin_range * sin(DEG_TO_RAD(PLANNER_SKIN_DEG - PLANNER_MARGIN_EPS_DEG));
+		user.motion_at_skin = planner.motion_total;
+	}
+	double slack = user.skin_slack - (planner.motion_total - user.motion_at_skin);
+
+	user.visible_sats.clear();
+	bool cones_built = false;
+	for (sat_id_t sat_id : user.skin_sats) {
+		vector_3d_t sat_pos = position_at(scenario.sats, sat_id);
+
+		// Constraint: sat must be visible to user, the complement of angle_at_most
+		double dot_product, mag_product;
+		angle_terms(user_pos, ORIGIN, sat_pos, &dot_product, &mag_product);
+		if (mag_product == 0) {
+			// no direction to measure a margin with
+			slack = 0;
+			continue;
+		}
+		bool visible = dot_product < PlannerConfig::cos_user_visible_bound * mag_product;
+		double angle = RAD_TO_DEG(acos(MAX(-1.0, MIN(1.0, dot_product / mag_product))));
+		double margin_deg = fabs(angle - (180.0 - PlannerConfig::max_user_visible_angle));
+
+		// Constraint: angle with user must not be too small w/ interferer
+		if (visible) {
+			if (!cones_built) {
+				build_interferer_cones<PlannerConfig>(scenario, user_i, scratch.cones);
+				cones_built = true;
+			}
+			if (!interferer_violation<PlannerConfig>(scenario, scratch.cones, user_i, user_pos, sat_pos)) {
+				user.visible_sats.push_back(sat_id);
+			}
+			margin_deg = MIN(margin_deg, interferer_margin_deg(scratch.cones, user_pos, sat_pos));
+		}
+
+		float d[3] = {sat_pos[0] - user_pos[0], sat_pos[1] - user_pos[1], sat_pos[2] - user_pos[2]};
+		double range = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		margin_deg = MIN(90.0, MAX(0.0, margin_deg - PLANNER_MARGIN_EPS_DEG));
+		slack = MIN(slack, range * sin(DEG_TO_RAD(margin_deg)));
+	}
+
+	user.slack = slack;
+	user.motion_at_eval = planner.motion_total;
+	user.needs_eval = false;
+	user.stamp ++;
+	user.waiting = false;
+}
+
+static inline void evaluate_planner_users(Planner& planner, const vector<user_id_t>& user_ids) {
+	/**
+	 * evaluate_planner_user for every user in user_ids, in chunks over options.num_threads threads, 
+	 * and put each back on the slack heap. user_ids mustn't repeat. 
+	 * */
+	if (user_ids.empty()) {
+		return;
+	}
+	if (planner.sat_grid_stale) {
+		planner.sat_grid = build_sat_grid(planner.scenario, planner.sat_beam_list);
+		planner.sat_grid_stale = false;
+	}
+
+	int num_users = (int) user_ids.size();
+	int num_chunks = (num_users + VIS_CHUNK_USERS - 1) / VIS_CHUNK_USERS;
+	parallel_for_chunks(num_chunks, planner.options.num_threads, [&](int chunk_i) {
+		VisScratch scratch = {};
+		scratch.mask_kernel = select_vis_mask_kernel(planner.options.use_simd);
+		int chunk_end = MIN(num_users, (chunk_i + 1) * VIS_CHUNK_USERS);
+		for (int i = chunk_i * VIS_CHUNK_USERS; i < chunk_end; i ++) {
+			evaluate_planner_user(planner, user_ids[i], scratch, planner.users[user_ids[i]]);
+		}
+	});
+	for (user_id_t user_i : user_ids) {
+		const PlannerUser& user = planner.users[user_i];
+		planner.slack_heap.push({user.motion_at_eval + user.slack, user_i, user.stamp});
+	}
+}
+
+static inline void queue_eval(Planner& planner, user_id_t user_i) {
+	PlannerUser& user = planner.users[user_i];
+	if (!user.needs_eval) {
+		user.needs_eval = true;
+		planner.eval_queue.push_back(user_i);
+	}
+}
+
+static inline void queue_assign(Planner& planner, user_id_t user_i) {
+	PlannerUser& user = planner.users[user_i];
+	if (!user.needs_assign) {
+		user.needs_assign = true;
+		planner.assign_queue.push_back(user_i);
+	}
+}
+
+static inline bool planner_waiter_valid(const Planner& planner, const PlannerWaiter& waiter) {
+	/**
+	 * waiter's user is still unassigned with the visible sats it was listed under
+	 * */
+	const PlannerUser& user = planner.users[waiter.user_id];
+	return user.active && user.sat_id < 0 && user.stamp == waiter.stamp;
+}
+
+static inline void compact_sat_waiting(Planner& planner, sat_id_t sat_i) {
+	vector<PlannerWaiter>& waiting = planner.sat_waiting[sat_i];
+	waiting.erase(remove_if(waiting.begin(), waiting.end(), [&](const PlannerWaiter& waiter) {
+		return !planner_waiter_valid(planner, waiter);
+	}), waiting.end());
+	planner.sat_waiting_compacted[sat_i] = (int) waiting.size();
+}
+
+static inline void list_waiting_user(Planner& planner, user_id_t user_i) {
+	/**
+	 * List unassigned user_i under each of its visible sats, unless it already is
+	 * */
+	PlannerUser& user = planner.users[user_i];
+	if (user.waiting) {
+		return;
+	}
+	for (sat_id_t sat_i : user.visible_sats) {
+		vector<PlannerWaiter>& waiting = planner.sat_waiting[sat_i];
+		waiting.push_back({user_i, user.stamp});
+		if ((int) waiting.size() > 2 * MAX(16, planner.sat_waiting_compacted[sat_i])) {
+			compact_sat_waiting(planner, sat_i);
+		}
+	}
+	user.waiting = true;
+}
+
+static inline void free_planner_beam(Planner& planner, user_id_t user_i) {
+	/**
+	 * Take user_i's beam away, if it has one, and queue the user for a new one
+	 * */
+	PlannerUser& user = planner.users[user_i];
+	queue_assign(planner, user_i);
+	if (user.sat_id < 0) {
+		return;
+	}
+	SatBeamEntry<PlannerConfig>& beam_entry = planner.sat_beam_list[user.sat_id];
+	beam_entry.color_beams[user.color_i] &= ~((beam_mask_t) 1 << user.beam_slot);
+	beam_entry.total_sat_beam_count -= 1;
+	planner.beam_users[user.sat_id * PlannerConfig::beams_per_satellite + user.beam_slot] = -1;
+	if (!planner.sat_freed[user.sat_id]) {
+		planner.sat_freed[user.sat_id] = 1;
+		planner.freed_sats.push_back(user.sat_id);
+	}
+	user.sat_id = -1;
+}
+
+static inline bool assign_planner_user(Planner& planner, user_id_t user_i) {
+	/**
+	 * Give user_i a beam on the first of its visible sats that can take one, the same greedy step
+	 * as assign_beams, but into the lowest free slot. Returns false if none could.
+	 * */
+	PlannerUser& user = planner.users[user_i];
+	vector_3d_t user_pos = position_at(planner.scenario.users, user_i);
+	for (sat_id_t sat_i : user.visible_sats) {
+		SatBeamEntry<PlannerConfig>& beam_entry = planner.sat_beam_list[sat_i];
+		if (beam_entry.total_sat_beam_count >= PlannerConfig::beams_per_satellite) {
+			continue;
+		}
+
+		vector_3d_t sat_pos = position_at(planner.scenario.sats, sat_i);
+		vector_3d_t user_dir = beam_dir_of(sat_pos, user_pos);
+		int color_i = find_beam_color(beam_entry, sat_pos, user_pos, user_dir);
+		if (color_i < 0) {
+			continue;
+		}
+
+		beam_mask_t used_beams = 0;
+		for (beam_mask_t color_beams : beam_entry.color_beams) {
+			used_beams |= color_beams;
+		}
+		int slot = __builtin_ctzll(~used_beams);
+		beam_entry.beam_targets[slot] = user_pos;
+		beam_entry.beam_dirs[slot] = user_dir;
+		beam_entry.color_beams[color_i] |= (beam_mask_t) 1 << slot;
+		beam_entry.total_sat_beam_count += 1;
+
+		planner.beam_users[sat_i * PlannerConfig::beams_per_satellite + slot] = user_i;
+		user.sat_id = sat_i;
+		user.beam_slot = (uint8_t) slot;
+		user.color_i = (uint8_t) color_i;
+
+		// its sat_waiting entries lapse, so if it loses the beam it has to be listed again
+		user.waiting = false;
+		return true;
+	}
+	return false;
+}
+
+static inline void repair_sat_beams(Planner& planner, sat_id_t sat_i) {
+	/**
+	 * After sat_i moves, recompute its beams' directions and free any beam that now self interferes with
+	 * a lower slot beam of the same color
+	 * */
+	SatBeamEntry<PlannerConfig>& beam_entry = planner.sat_beam_list[sat_i];
+	vector_3d_t sat_pos = position_at(planner.scenario.sats, sat_i);
+	for (int color_i = 0; color_i < PlannerConfig::colors_per_satellite; color_i ++) {
+		beam_mask_t kept = 0;
+		for (beam_mask_t beams = beam_entry.color_beams[color_i]; beams != 0; beams &= beams - 1) {
+			int beam_i = __builtin_ctzll(beams);
+			const vector_3d_t& beam_target = beam_entry.beam_targets[beam_i];
+			beam_entry.beam_dirs[beam_i] = beam_dir_of(sat_pos, beam_target);
+
+			bool self_interference = false;
+			for (beam_mask_t others = kept; others != 0; others &= others - 1) {
+				int other_i = __builtin_ctzll(others);
+				if (beams_self_interfere<PlannerConfig>(sat_pos, beam_target, beam_entry.beam_dirs[beam_i], 
+										 beam_entry.beam_targets[other_i], beam_entry.beam_dirs[other_i])) {
+					self_interference = true;
+					break;
+				}
+			}
+			if (self_interference) {
+				free_planner_beam(planner, planner.beam_users[sat_i * PlannerConfig::beams_per_satellite + beam_i]);
+			} else {
+				kept |= (beam_mask_t) 1 << beam_i;
+			}
+		}
+	}
+}
+
+static inline void init_planner(Planner& planner, const Scenario& scenario, const SolveOptions& options) {
+	/**
+	 * Solve scenario from scratch into planner. The plan is the one solve_scenario gives.
+	 * */
+	planner = {};
+	planner.scenario = scenario;
+	planner.options = options;
+	planner.min_sat_mag = min_sat_mag_of(scenario);
+
+	int num_sats = num_positions(scenario.sats);
+	int num_users = num_positions(scenario.users);
+	planner.sat_beam_list.resize(num_sats);
+	for (int sat_i = 0; sat_i < num_sats; sat_i ++) {
+		planner.sat_beam_list[sat_i] = {};
+		planner.sat_beam_list[sat_i].sat_id = sat_i;
+	}
+	planner.beam_users.assign((size_t) num_sats * PlannerConfig::beams_per_satellite, -1);
+	planner.sat_moved.assign(num_sats, 0);
+	planner.sat_freed.assign(num_sats, 0);
+	planner.sat_waiting.assign(num_sats, {});
+	planner.sat_waiting_compacted.assign(num_sats, 0);
+	planner.sat_grid_stale = true;
+
+	PlannerUser new_user = {};
+	new_user.active = true;
+	new_user.sat_id = -1;
+	planner.users.assign(num_users, new_user);
+	vector<user_id_t> user_ids(num_users);
+	for (int user_i = 0; user_i < num_users; user_i ++) {
+		user_ids[user_i] = user_i;
+	}
+	evaluate_planner_users(planner, user_ids);
+
+	// first plan goes through the batch stages, so it matches solve_scenario exactly
+	SolveArena<PlannerConfig> arena = {};
+	arena.sat_beam_list = move(planner.sat_beam_list);
+	for (int user_i = 0; user_i < num_users; user_i ++) {
+		const vector<sat_id_t>& visible_sats = planner.users[user_i].visible_sats;
+		arena.user_vis_list.push_back({user_i, (int) arena.visible_sat_ids.size(), (int) visible_sats.size()});
+		arena.visible_sat_ids.insert(arena.visible_sat_ids.end(), visible_sats.begin(), visible_sats.end());
+		for (sat_id_t sat_i : visible_sats) {
+			arena.visible_sat_dirs.push_back(beam_dir_of(position_at(scenario.sats, sat_i), position_at(scenario.users, user_i)));
+		}
+	}
+	sort_user_vis_list(arena);
+	assign_beams(planner.scenario, arena);
+	planner.sat_beam_list = move(arena.sat_beam_list);
+
+	for (const BeamAssignment& assignment : arena.assignments) {
+		PlannerUser& user = planner.users[assignment.user_id];
+		user.sat_id = assignment.sat_id;
+		user.beam_slot = (uint8_t) (assignment.beam_id - 1);
+		user.color_i = assignment.color_i;
+		planner.beam_users[assignment.sat_id * PlannerConfig::beams_per_satellite + user.beam_slot] = assignment.user_id;
+	}
+	for (int user_i = 0; user_i < num_users; user_i ++) {
+		if (planner.users[user_i].sat_id < 0) {
+			list_waiting_user(planner, user_i);
+		}
+	}
+}
+
+static inline void update_sat_positions(Planner& planner, const vector<vector_3d_t>& sat_positions) {
+	/**
+	 * Move every sat, sat_positions[i] being the new position of sat i
+	 * */
+	assert((int) sat_positions.size() == num_positions(planner.scenario.sats));
+	double max_move = 0;
+	for (int sat_i = 0; sat_i < (int) sat_positions.size(); sat_i ++) {
+		vector_3d_t old_pos = position_at(planner.scenario.sats, sat_i);
+		const vector_3d_t& new_pos = sat_positions[sat_i];
+		double d[3] = {(double) new_pos[0] - old_pos[0], (double) new_pos[1] - old_pos[1], (double) new_pos[2] - old_pos[2]};
+		double move = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		if (move == 0) {
+			continue;
+		}
+		set_position(planner.scenario.sats, sat_i, new_pos);
+		planner.sat_moved[sat_i] = 1;
+		max_move = MAX(max_move, move);
+	}
+	if (max_move == 0) {
+		return;
+	}
+	planner.motion_total += max_move;
+	planner.min_sat_mag = min_sat_mag_of(planner.scenario);
+	planner.sat_grid_stale = true;
+}
+
+static inline user_id_t add_user(Planner& planner, vector_3d_t user_pos) {
+	/**
+	 * Add a user at user_pos, returning its id, which is a removed user's if there is one. It gets 
+	 * a beam, if it can, on the next replan.
+	 * */
+	user_id_t user_i;
+	if (!planner.free_user_ids.empty()) {
+		user_i = planner.free_user_ids.back();
+		planner.free_user_ids.pop_back();
+		set_position(planner.scenario.users, user_i, user_pos);
+	} else {
+		user_i = (user_id_t) planner.users.size();
+		push_position(planner.scenario.users, user_pos);
+		planner.users.push_back({});
+	}
+
+	// a reused id may still be queued from before it was removed, which the queue flags carry over
+	PlannerUser& user = planner.users[user_i];
+	user.active = true;
+	user.stamp ++;
+	user.waiting = false;
+	user.visible_sats.clear();
+	user.skin_sats.clear();
+	user.slack = 0;
+	user.motion_at_eval = 0;
+	user.skin_slack = 0;
+	user.motion_at_skin = 0;
+	user.sat_id = -1;
+	queue_eval(planner, user_i);
+	queue_assign(planner, user_i);
+	return user_i;
+}
+
+static inline void remove_user(Planner& planner, user_id_t user_i) {
+	/**
+	 * Drop user_i and free its beam. Its id is free for add_user to reuse. If it's queued it stays 
+	 * queued, and replan skips it while it's inactive.
+	 * */
+	PlannerUser& user = planner.users[user_i];
+	if (!user.active) {
+		return;
+	}
+	free_planner_beam(planner, user_i);
+	user.active = false;
+	user.stamp ++;
+	user.visible_sats.clear();
+	user.skin_sats.clear();
+	planner.free_user_ids.push_back(user_i);
+}
+
+static inline void replan(Planner& planner) {
+	/**
+	 * Bring the plan up to date with every update since the last replan:
+	 * - recompute visibility of users whose slack ran out, dropping beams to sats they lost
+	 * - repair self interference on sats that moved
+	 * - greedily assign users with no beam that were re-evaluated, lost their beam, or see a
+	 * 		sat that freed one, least coverage first like sort_user_vis_list
+	 * */
+	// new users, and users whose slack has run out
+	vector<user_id_t> eval_ids = {};
+	for (user_id_t user_i : planner.eval_queue) {
+		PlannerUser& user = planner.users[user_i];
+		if (user.active) {
+			eval_ids.push_back(user_i);
+		} else {
+			user.needs_eval = false;
+		}
+	}
+	planner.eval_queue.clear();
+	while (!planner.slack_heap.empty() && planner.slack_heap.top().motion_total <= planner.motion_total) {
+		PlannerSlackDeadline deadline = planner.slack_heap.top();
+		planner.slack_heap.pop();
+		const PlannerUser& user = planner.users[deadline.user_id];
+		if (user.active && user.stamp == deadline.stamp) {
+			eval_ids.push_back(deadline.user_id);
+		}
+	}
+	sort(eval_ids.begin(), eval_ids.end());
+	evaluate_planner_users(planner, eval_ids);
+
+	for (user_id_t user_i : eval_ids) {
+		PlannerUser& user = planner.users[user_i];
+		if (user.sat_id < 0) {
+			queue_assign(planner, user_i);
+		} else if (!binary_search(user.visible_sats.begin(), user.visible_sats.end(), user.sat_id)) {
+			free_planner_beam(planner, user_i);
+		}
+	}
+
+	int num_sats = (int) planner.sat_beam_list.size();
+	for (int sat_i = 0; sat_i < num_sats; sat_i ++) {
+		if (planner.sat_moved[sat_i]) {
+			repair_sat_beams(planner, sat_i);
+			planner.sat_moved[sat_i] = 0;
+		}
+	}
+
+	// unassigned users that were queued or wait on a sat that freed a beam
+	vector<user_id_t> pending = {};
+	auto add_pending = [&](user_id_t user_i) {
+		PlannerUser& user = planner.users[user_i];
+		if (user.active && user.sat_id < 0 && !user.pending) {
+			user.pending = true;
+			pending.push_back(user_i);
+		}
+	};
+	for (user_id_t user_i : planner.assign_queue) {
+		planner.users[user_i].needs_assign = false;
+		add_pending(user_i);
+	}
+	planner.assign_queue.clear();
+	for (sat_id_t sat_i : planner.freed_sats) {
+		compact_sat_waiting(planner, sat_i);
+		for (const PlannerWaiter& waiter : planner.sat_waiting[sat_i]) {
+			add_pending(waiter.user_id);
+		}
+		planner.sat_freed[sat_i] = 0;
+	}
+	planner.freed_sats.clear();
+
+	// least coverage first, ties in user id order
+	sort(pending.begin(), pending.end(), [&](user_id_t u1, user_id_t u2) {
+		size_t n1 = planner.users[u1].visible_sats.size();
+		size_t n2 = planner.users[u2].visible_sats.size();
+		return n1 != n2 ? n1 < n2 : u1 < u2;
+	});
+	for (user_id_t user_i : pending) {
+		planner.users[user_i].pending = false;
+		if (!assign_planner_user(planner, user_i)) {
+			list_waiting_user(planner, user_i);
+		}
+	}
+}
+
+static inline void planner_assignments(const Planner& planner, vector<BeamAssignment>& out_assignments) {
+	/**
+	 * The current plan, for format_assignments, in user id order
+	 * */
+	out_assignments.clear();
+	for (int user_i = 0; user_i < (int) planner.users.size(); user_i ++) {
+		const PlannerUser& user = planner.users[user_i];
+		if (user.active && user.sat_id >= 0) {
+			out_assignments.push_back({user.sat_id, user_i, (uint8_t) (user.beam_slot + 1), user.color_i});
+		}
+	}
+}
+
+#endif // PLANNER_H
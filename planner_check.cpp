@@ -0,0 +1,173 @@
+#include "solver.h"
+#include "validate.h"
+#include "planner.h"
+#include <random>
+#include <sstream>
+
+/**
+ * Drives a Planner (see planner.h) through a run of ticks over a scenario and validates every
+ * tick's plan. Each tick rotates the constellation about the z axis, removes some random users and
+ * adds as many new ones near existing users, replans, and runs validate.h's checks on the plan
+ * against the planner's scenario. A tick whose plan fails prints the validator's report and the
+ * run exits 1. A removed user stays in the planner's scenario until its id is reused, so it counts
+ * as uncovered. Each tick also prints the planner's user slots, which stay near the starting users
+ * since ids are reused.
+ *
+ * Typical use:
+ * 		./planner_check --ticks 50 --churn 100 test_cases/09_ten_thousand_users.txt
+ * */
+
+struct PlannerCheckOptions {
+	int num_ticks;
+	int churn;
+	double rotate_deg;
+	unsigned seed;
+	string scenario_path;
+};
+
+static void rotate_sats(const Scenario& scenario, double rotate_deg, vector<vector_3d_t>& out_positions) {
+	/**
+	 * Every sat of scenario rotated by rotate_deg about the z axis
+	 * */
+	double c = cos(DEG_TO_RAD(rotate_deg));
+	double s = sin(DEG_TO_RAD(rotate_deg));
+	out_positions.resize(num_positions(scenario.sats));
+	for (int sat_i = 0; sat_i < num_positions(scenario.sats); sat_i ++) {
+		vector_3d_t pos = position_at(scenario.sats, sat_i);
+		out_positions[sat_i] = {(float) (pos[0] * c - pos[1] * s), (float) (pos[0] * s + pos[1] * c), pos[2]};
+	}
+}
+
+static void churn_users(Planner& planner, int churn, mt19937& rng) {
+	/**
+	 * Remove up to churn random active users, then add churn users, each a random existing user's
+	 * position nudged by up to ~50km, so new users land where the scenario's users are dense
+	 * */
+	vector<user_id_t> active_ids;
+	for (int user_i = 0; user_i < (int) planner.users.size(); user_i ++) {
+		if (planner.users[user_i].active) {
+			active_ids.push_back(user_i);
+		}
+	}
+	if (active_ids.empty()) {
+		return;
+	}
+	shuffle(active_ids.begin(), active_ids.end(), rng);
+	int num_removed = MIN(churn, (int) active_ids.size() - 1);
+	for (int i = 0; i < num_removed; i ++) {
+		remove_user(planner, active_ids[i]);
+	}
+
+	uniform_real_distribution<float> nudge(-50.0f, 50.0f);
+	for (int i = 0; i < churn; i ++) {
+		vector_3d_t pos = position_at(planner.scenario.users, active_ids[num_removed + i % ((int) active_ids.size() - num_removed)]);
+		float mag = sqrt(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+		vector_3d_t moved = {pos[0] + nudge(rng), pos[1] + nudge(rng), pos[2] + nudge(rng)};
+		float moved_mag = sqrt(moved[0] * moved[0] + moved[1] * moved[1] + moved[2] * moved[2]);
+
+		// back onto the user's sphere
+		add_user(planner, {moved[0] * mag / moved_mag, moved[1] * mag / moved_mag, moved[2] * mag / moved_mag});
+	}
+}
+
+static bool check_tick(const Planner& planner, int tick, double replan_ms) {
+	/**
+	 * Validate planner's current plan, printing a line for the tick, or the validator's report if
+	 * the plan fails
+	 * */
+	vector<BeamAssignment> assignments;
+	planner_assignments(planner, assignments);
+
+	// the validator wants each sat's beams together, like a solution file
+	stable_sort(assignments.begin(), assignments.end(), [](const BeamAssignment& a, const BeamAssignment& b) {
+		return a.sat_id < b.sat_id;
+	});
+	ValidationScenario scenario;
+	validation_scenario_of(planner.scenario, scenario);
+
+	// the report only matters if the plan fails
+	stringstream report;
+	streambuf* cout_buff = cout.rdbuf(report.rdbuf());
+	bool valid = validate_assignments<PlannerConfig>(scenario, assignments);
+	cout.rdbuf(cout_buff);
+
+	int num_active = 0;
+	for (const PlannerUser& user : planner.users) {
+		num_active += user.active;
+	}
+	printf("tick %4d: %8d users %8d slots %8d beams %10.3f ms replan %s\n", tick, num_active, (int) planner.users.size(), 
+		   (int) assignments.size(), replan_ms, valid ? "valid" : "INVALID");
+	if (!valid) {
+		cout << report.str();
+	}
+	fflush(stdout);
+	return valid;
+}
+
+int main(int argc, char** argv)
+{
+	PlannerCheckOptions options = {};
+	options.num_ticks = 20;
+	options.churn = 50;
+	options.rotate_deg = 0.05;
+	options.seed = 1;
+	bool args_ok = true;
+	for (int i = 1; i < argc; i ++) {
+		string arg = argv[i];
+		if (arg == "--ticks" && i + 1 < argc) {
+			options.num_ticks = atoi(argv[++ i]);
+		} else if (arg == "--churn" && i + 1 < argc) {
+			int churn = atoi(argv[++ i]);
+			options.churn = MAX(0, churn);
+		} else if (arg == "--rotate-deg" && i + 1 < argc) {
+			options.rotate_deg = atof(argv[++ i]);
+		} else if (arg == "--seed" && i + 1 < argc) {
+			options.seed = (unsigned) strtoul(argv[++ i], nullptr, 10);
+		} else if (arg.rfind("--", 0) != 0 && options.scenario_path == "") {
+			options.scenario_path = arg;
+		} else {
+			args_ok = false;
+		}
+	}
+	if (!args_ok || options.scenario_path == "") {
+		cout << "Expected arguments: [--ticks N] [--churn N] [--rotate-deg DEG] [--seed S] /path/to/scenario.{txt,bin}" << endl;
+		return 0;
+	}
+
+	MappedFile scenario_file;
+	if (!map_file(options.scenario_path, &scenario_file)) {
+		cout << "File \'" << options.scenario_path << "\' does not exist" << endl;
+		return 1;
+	}
+	Scenario scenario = {};
+	vector<SatBeamEntry<PlannerConfig>> sat_beam_list;
+	bool parsed = load_scenario(scenario_file.data, scenario_file.size, scenario, sat_beam_list);
+	unmap_file(scenario_file);
+	if (!parsed) {
+		return 1;
+	}
+
+	Planner planner;
+	auto start = chrono::steady_clock::now();
+	init_planner(planner, scenario, default_solve_options());
+	double init_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	if (!check_tick(planner, 0, init_ms)) {
+		return 1;
+	}
+
+	mt19937 rng(options.seed);
+	vector<vector_3d_t> sat_positions;
+	for (int tick = 1; tick <= options.num_ticks; tick ++) {
+		rotate_sats(planner.scenario, options.rotate_deg, sat_positions);
+		update_sat_positions(planner, sat_positions);
+		churn_users(planner, options.churn, rng);
+
+		start = chrono::steady_clock::now();
+		replan(planner);
+		double replan_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		if (!check_tick(planner, tick, replan_ms)) {
+			return 1;
+		}
+	}
+	return 0;
+}
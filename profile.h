@@ -0,0 +1,254 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+/**
+ * Hot-path instrumentation: event counters and per-stage timers, compiled in only with -DPROFILE
+ * (make PROFILE=1). Without it every PROFILE_* macro is a no-op and nothing here is referenced.
+ *
+ * Counters are per thread, so counting in a parallel stage never contends; each thread's counts
+ * are added to the process totals when it exits (or when a stage timer flushes the calling
+ * thread). A stage timer records its stage's wall time and how much each counter moved while it
+ * ran, so the summary shows e.g. how many exact angle checks visibility did vs assignment.
+ *
+ * Typical use:
+ * 		PROFILE_BEGIN(PROFILE_STAGE_SORT);
+ * 		sort_user_vis_list(arena);
+ * 		PROFILE_END(PROFILE_STAGE_SORT);
+ * 		...
+ * 		print_profile_summary();
+ * */
+
+enum ProfileCounter {
+	// exact (double) angle checks, the solver's calc_angle calls
+	PROFILE_ANGLE_CHECKS,
+
+	// sats the sat grid and visibility mask hand to the per-sat visibility checks, and their fates
+	PROFILE_VIS_CANDIDATES,
+	PROFILE_VIS_REJECTED_VISIBILITY,
+	PROFILE_VIS_REJECTED_INTERFERER,
+	PROFILE_VIS_ACCEPTED,
+
+	// interferer cones dot tested against a sat, and those left to the exact check
+	PROFILE_INTERFERER_CONE_TESTS,
+	PROFILE_INTERFERER_EXACT_CHECKS,
+
+	// same-color beam pairs tested for self interference, and those left to the exact check
+	PROFILE_SELF_INTERFERENCE_TESTS,
+	PROFILE_SELF_INTERFERENCE_EXACT_CHECKS,
+
+	// candidate sats assignment skipped for having every beam used
+	PROFILE_ASSIGN_SAT_FULL,
+
+	// color scans of a sat for a new beam, and scans where every color of the config conflicted
+	PROFILE_ASSIGN_COLOR_SCANS,
+	PROFILE_ASSIGN_COLOR_FAILURES,
+
+	// users the greedy couldn't place on any of their visible sats
+	PROFILE_ASSIGN_USERS_UNASSIGNED,
+
+	NUM_PROFILE_COUNTERS
+};
+
+enum ProfileStage {
+	PROFILE_STAGE_PARSE,
+	PROFILE_STAGE_GRID,
+	PROFILE_STAGE_VISIBILITY,
+	PROFILE_STAGE_SORT,
+	PROFILE_STAGE_ASSIGN,
+	PROFILE_STAGE_OUTPUT,
+	NUM_PROFILE_STAGES
+};
+
+#ifdef PROFILE
+
+static const char* PROFILE_COUNTER_NAMES[NUM_PROFILE_COUNTERS] = {
+	"angle_checks",
+	"vis_candidates", "vis_rejected_visibility", "vis_rejected_interferer", "vis_accepted",
+	"interferer_cone_tests", "interferer_exact_checks",
+	"self_interference_tests", "self_interference_exact_checks",
+	"assign_sat_full",
+	"assign_color_scans", "assign_color_failures",
+	"assign_users_unassigned"
+};
+static const char* PROFILE_STAGE_NAMES[NUM_PROFILE_STAGES] = {"parse", "grid", "visibility", "sort", "assign", "output"};
+
+using profile_clock = chrono::steady_clock;
+
+struct ProfileTotals {
+	/**
+	 * Process wide results, guarded by lock
+	 */
+	mutex lock;
+	uint64_t counts[NUM_PROFILE_COUNTERS];
+
+	// wall time of each stage and how far each counter moved during it, summed over runs
+	double stage_ms[NUM_PROFILE_STAGES];
+	uint64_t stage_counts[NUM_PROFILE_STAGES][NUM_PROFILE_COUNTERS];
+	int stage_runs[NUM_PROFILE_STAGES];
+};
+
+static inline ProfileTotals& profile_totals() {
+	static ProfileTotals totals;
+	return totals;
+}
+
+struct ThreadProfileCounts {
+	/**
+	 * One thread's counts since it last flushed, added to profile_totals() when the thread exits
+	 */
+	uint64_t counts[NUM_PROFILE_COUNTERS];
+
+	~ThreadProfileCounts() {
+		ProfileTotals& totals = profile_totals();
+		lock_guard<mutex> guard(totals.lock);
+		for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter ++) {
+			totals.counts[counter] += counts[counter];
+		}
+	}
+};
+
+static inline ThreadProfileCounts& thread_profile_counts() {
+	static thread_local ThreadProfileCounts thread_counts = {};
+	return thread_counts;
+}
+
+static inline void flush_thread_profile_counts(uint64_t* out_counts) {
+	/**
+	 * Add the calling thread's counts to profile_totals() and copy the new totals to out_counts
+	 * */
+	ThreadProfileCounts& thread_counts = thread_profile_counts();
+	ProfileTotals& totals = profile_totals();
+	lock_guard<mutex> guard(totals.lock);
+	for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter ++) {
+		totals.counts[counter] += thread_counts.counts[counter];
+		thread_counts.counts[counter] = 0;
+	}
+	memcpy(out_counts, totals.counts, sizeof(totals.counts));
+}
+
+struct ProfileStageTimer {
+	ProfileStage stage;
+	profile_clock::time_point start;
+	uint64_t counts_at_start[NUM_PROFILE_COUNTERS];
+};
+
+static inline ProfileStageTimer begin_profile_stage(ProfileStage stage) {
+	ProfileStageTimer timer;
+	timer.stage = stage;
+	flush_thread_profile_counts(timer.counts_at_start);
+	timer.start = profile_clock::now();
+	return timer;
+}
+
+static inline void end_profile_stage(const ProfileStageTimer& timer) {
+	/**
+	 * Record timer's stage. Any threads the stage spawned must have exited (been joined) by now
+	 * for their counts to be attributed to it.
+	 * */
+	double ms = chrono::duration<double, milli>(profile_clock::now() - timer.start).count();
+	uint64_t counts_at_end[NUM_PROFILE_COUNTERS];
+	flush_thread_profile_counts(counts_at_end);
+
+	ProfileTotals& totals = profile_totals();
+	lock_guard<mutex> guard(totals.lock);
+	totals.stage_ms[timer.stage] += ms;
+	totals.stage_runs[timer.stage] += 1;
+	for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter ++) {
+		totals.stage_counts[timer.stage][counter] += counts_at_end[counter] - timer.counts_at_start[counter];
+	}
+}
+
+static inline void print_profile_summary() {
+	/**
+	 * Stage times and counters, one column per stage that ran, as a table on stderr
+	 * */
+	uint64_t counts[NUM_PROFILE_COUNTERS];
+	flush_thread_profile_counts(counts);
+	ProfileTotals& totals = profile_totals();
+	lock_guard<mutex> guard(totals.lock);
+
+	fprintf(stderr, "%-32s %14s", "profile", "total");
+	for (int stage = 0; stage < NUM_PROFILE_STAGES; stage ++) {
+		if (totals.stage_runs[stage] > 0) {
+			fprintf(stderr, " %14s", PROFILE_STAGE_NAMES[stage]);
+		}
+	}
+	fprintf(stderr, "\n%-32s %14s", "ms", "");
+	for (int stage = 0; stage < NUM_PROFILE_STAGES; stage ++) {
+		if (totals.stage_runs[stage] > 0) {
+			fprintf(stderr, " %14.3f", totals.stage_ms[stage]);
+		}
+	}
+	fprintf(stderr, "\n");
+	for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter ++) {
+		fprintf(stderr, "%-32s %14llu", PROFILE_COUNTER_NAMES[counter], (unsigned long long) counts[counter]);
+		for (int stage = 0; stage < NUM_PROFILE_STAGES; stage ++) {
+			if (totals.stage_runs[stage] > 0) {
+				fprintf(stderr, " %14llu", (unsigned long long) totals.stage_counts[stage][counter]);
+			}
+		}
+		fprintf(stderr, "\n");
+	}
+}
+
+static inline string profile_summary_json() {
+	/**
+	 * Same as print_profile_summary, as a JSON object
+	 * */
+	uint64_t counts[NUM_PROFILE_COUNTERS];
+	flush_thread_profile_counts(counts);
+	ProfileTotals& totals = profile_totals();
+	lock_guard<mutex> guard(totals.lock);
+
+	char buff[128];
+	string json = "{\n  \"counters\": {";
+	for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter ++) {
+		snprintf(buff, sizeof(buff), "%s\"%s\": %llu", counter > 0 ? ", " : "", PROFILE_COUNTER_NAMES[counter],
+				 (unsigned long long) counts[counter]);
+		json += buff;
+	}
+	json += "},\n  \"stages\": [\n";
+	bool first_stage = true;
+	for (int stage = 0; stage < NUM_PROFILE_STAGES; stage ++) {
+		if (totals.stage_runs[stage] == 0) {
+			continue;
+		}
+		snprintf(buff, sizeof(buff), "%s    {\"name\": \"%s\", \"runs\": %d, \"ms\": %.3f, \"counters\": {",
+				 first_stage ? "" : ",\n", PROFILE_STAGE_NAMES[stage], totals.stage_runs[stage], totals.stage_ms[stage]);
+		json += buff;
+		for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter ++) {
+			snprintf(buff, sizeof(buff), "%s\"%s\": %llu", counter > 0 ? ", " : "", PROFILE_COUNTER_NAMES[counter],
+					 (unsigned long long) totals.stage_counts[stage][counter]);
+			json += buff;
+		}
+		json += "}}";
+		first_stage = false;
+	}
+	json += "\n  ]\n}\n";
+	return json;
+}
+
+#define PROFILE_ADD(counter, n) (thread_profile_counts().counts[counter] += (n))
+#define PROFILE_BEGIN(stage) ProfileStageTimer profile_timer_##stage = begin_profile_stage(stage)
+#define PROFILE_END(stage) end_profile_stage(profile_timer_##stage)
+
+#else
+
+#define PROFILE_ADD(counter, n) ((void) 0)
+#define PROFILE_BEGIN(stage) ((void) 0)
+#define PROFILE_END(stage) ((void) 0)
+
+#endif // PROFILE
+
+#define PROFILE_COUNT(counter) PROFILE_ADD(counter, 1)
+
+#endif // PROFILE_H
@@ -3,9 +3,13 @@ import sys
 import glob
 import timeit
 
+# validates with the native checker; evaluate.py is the reference it matches. 
+# Set VALIDATOR="python3 evaluate.py" to use it instead
+validator = os.environ.get("VALIDATOR", "./solution --validate")
+
 # runs tests, stores output w/ commit hash in results.csv
 def run_test(filename):
-    os.system("./solution " + filename + " | python3 evaluate.py " + filename)
+    os.system("./solution " + filename + " | " + validator + " " + filename)
 
 def run_all_tests(file_=None):
     if not file_:
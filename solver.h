@@ -0,0 +1,3506 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <type_traits>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#include "profile.h"
+#include "vis_gpu.h"
+
+using namespace std;
+
+// type aliases for different id types 
+using id_t_ = int;
+using sat_id_t = id_t_; 
+using user_id_t = id_t_; 
+
+using vector_3d_t = array<float, 3>;
+
+#define DEG_TO_RAD(deg) ((deg) * 3.141592653589793 / 180.0)
+#define RAD_TO_DEG(rad) ((rad) * 180.0 / 3.141592653589793)
+
+#define CONSTEXPR_TRIG_TERMS 30
+
+static constexpr double constexpr_taylor(double rad, int first_power) {
+	/**
+	 * sum over n of (-1)^n rad^(2n + first_power) / (2n + first_power)!, cos(rad) for first_power 0 and 
+	 * sin(rad) for 1, as a constant expression. Summed in long double, smallest terms first, and 
+	 * rounded once, so for |rad| <= pi it is within an ulp of libm's, and almost always bit for bit. 
+	 * */
+	long double x = rad;
+	long double terms[CONSTEXPR_TRIG_TERMS] = {};
+	long double term = first_power == 0 ? 1.0L : x;
+	for (int n = 0; n < CONSTEXPR_TRIG_TERMS; n ++) {
+		terms[n] = term;
+		term *= -x * x / ((2 * n + first_power + 1) * (2 * n + first_power + 2));
+	}
+	long double sum = 0.0L;
+	for (int n = CONSTEXPR_TRIG_TERMS - 1; n >= 0; n --) {
+		sum += terms[n];
+	}
+	return (double) sum;
+}
+
+static constexpr double constexpr_cos(double rad) {
+	return constexpr_taylor(rad, 0);
+}
+
+static constexpr double constexpr_sin(double rad) {
+	return constexpr_taylor(rad, 1);
+}
+
+struct StarlinkParams {
+	/**
+	 * The constellation evaluate.py checks: beams and colors per sat, and the constraint angles 
+	 * in degrees. Other constellation configs provide the same members, see SOLVER_CONFIGS. 
+	 */ 
+	static constexpr const char* name = "starlink";
+	static constexpr int beams_per_satellite = 32;
+	static constexpr int colors_per_satellite = 4;
+
+	// max user to sat beam angle from vertical
+	static constexpr double max_user_visible_angle = 45.0;
+
+	// a beam's min separation from a non-Starlink sat, as the user sees them
+	static constexpr double non_starlink_interference_max = 20.0;
+
+	// min separation of two same-colored beams of a sat, as the sat sees them
+	static constexpr double self_interference_max = 10.0;
+
+	// cosine band on the violating side of every constraint threshold that the solver treats as a 
+	// violation, see angle_violates. 0 decides every check exactly in double, like evaluate.py
+	static constexpr double boundary_guard_cos = 0.0;
+};
+
+template <typename Params>
+struct SolverConfig : Params {
+	/**
+	 * Params plus the constants the solver derives from them, all compile time. The solver is 
+	 * templated over one of these, so beam arrays are fixed size and color loops have a constant 
+	 * trip count. 
+	 */ 
+	// cosines of the constraint angles, so constraint checks can compare dot products instead of 
+	// calling acos. A user sees a sat when the origin-user-sat angle is > 180 - max_user_visible_angle
+	static constexpr double cos_user_visible_bound = constexpr_cos(DEG_TO_RAD(180.0 - Params::max_user_visible_angle));
+	static constexpr double cos_non_starlink_interference_max = constexpr_cos(DEG_TO_RAD(Params::non_starlink_interference_max));
+	static constexpr double sin_non_starlink_interference_max = constexpr_sin(DEG_TO_RAD(Params::non_starlink_interference_max));
+	static constexpr double cos_self_interference_max = constexpr_cos(DEG_TO_RAD(Params::self_interference_max));
+
+	// an interferer more than max_user_visible_angle + non_starlink_interference_max (and some slack) 
+	// from a user's zenith is never within non_starlink_interference_max of a sat the user sees
+	static constexpr double interferer_relevant_zenith = Params::max_user_visible_angle + Params::non_starlink_interference_max + 0.5;
+	static constexpr double cos_interferer_relevant_zenith = constexpr_cos(DEG_TO_RAD(interferer_relevant_zenith));
+
+	static_assert(Params::beams_per_satellite >= 1 && Params::beams_per_satellite <= 64, "beam_mask_t needs a bit per beam");
+	static_assert(Params::colors_per_satellite >= 1 && Params::colors_per_satellite <= 26, "colors are written as letters");
+	static_assert(interferer_relevant_zenith <= 180.0, "constexpr_cos needs |rad| <= pi");
+	static_assert(Params::boundary_guard_cos >= 0.0 && Params::boundary_guard_cos < 1e-4, "the float prefilters' margins must cover the guard band");
+};
+
+using StarlinkConfig = SolverConfig<StarlinkParams>;
+
+struct Starlink64BeamParams : StarlinkParams {
+	static constexpr const char* name = "starlink-64beam";
+	static constexpr int beams_per_satellite = 64;
+};
+
+struct Starlink8ColorParams : StarlinkParams {
+	static constexpr const char* name = "starlink-8color";
+	static constexpr int colors_per_satellite = 8;
+};
+
+struct StarlinkGuardedParams : StarlinkParams {
+	/**
+	 * Starlink, but nothing within 1e-5 (in cosine) of a threshold is emitted. Positions are parsed 
+	 * to float, which moves the angles evaluate.py computes from the text's doubles by ~2e-6 in 
+	 * cosine, and -ffast-math lets the compiler reorder the double checks. Outside the band neither 
+	 * can flip a decision, so its solutions pass evaluate.py and don't change across compilers. 
+	 */ 
+	static constexpr const char* name = "starlink-guarded";
+	static constexpr double boundary_guard_cos = 1e-5;
+};
+
+template <typename Config>
+struct ExactParams : Config {
+	/**
+	 * Config with no guard band, what evaluate.py checks a Config solution against. The validator 
+	 * runs under this, so a guarded config's solutions pass or fail exactly as they do in evaluate.py. 
+	 */ 
+	static constexpr double boundary_guard_cos = 0.0;
+};
+
+template <typename Config>
+using ExactConfig = SolverConfig<ExactParams<Config>>;
+
+// every prebuilt config, selectable at runtime by name (SolveOptions::config), see with_solver_config
+template <typename... configs_t>
+struct SolverConfigList {};
+using SOLVER_CONFIGS = SolverConfigList<StarlinkConfig, SolverConfig<Starlink64BeamParams>, SolverConfig<Starlink8ColorParams>, 
+										SolverConfig<StarlinkGuardedParams>>;
+
+template <typename config_fn_t, typename... configs_t>
+static inline bool with_solver_config(SolverConfigList<configs_t...>, const string& name, config_fn_t&& config_fn) {
+	/**
+	 * Calls config_fn(Config()) for the config in the list called name. Returns false if there's none. 
+	 * */
+	return ((name == configs_t::name ? (config_fn(configs_t()), true) : false) || ...);
+}
+
+template <typename config_fn_t>
+static inline bool with_solver_config(const string& name, config_fn_t&& config_fn) {
+	return with_solver_config(SOLVER_CONFIGS(), name, config_fn);
+}
+
+template <typename... configs_t>
+static inline string solver_config_names(SolverConfigList<configs_t...>) {
+	string names = "";
+	((names += names == "" ? string(configs_t::name) : string("|") + configs_t::name), ...);
+	return names;
+}
+
+static inline string solver_config_names() {
+	return solver_config_names(SOLVER_CONFIGS());
+}
+
+static inline char color_id_of(int color_i) {
+	/**
+	 * Letter of color color_i in solutions, 'A' for 0
+	 * */
+	return (char) ('A' + color_i);
+}
+
+static const vector_3d_t ORIGIN = {0,0,0};
+
+struct FloatArray {
+	/**
+	 * One array of a PositionArray: floats it owns, or while view isn't nullptr, a read-only view of 
+	 * view_size floats in a loaded binary scenario (see load_binary_scenario). Change it through 
+	 * owned_floats, which copies a view into owned first, so only callers that grow or move 
+	 * positions (parsers, the planner) ever pay for a copy. 
+	 */ 
+	vector<float> owned;
+	const float* view;
+	size_t view_size;
+
+	size_t size() const { return view != nullptr ? view_size : owned.size(); }
+	const float* data() const { return view != nullptr ? view : owned.data(); }
+	float operator[](size_t i) const { return data()[i]; }
+	const float* begin() const { return data(); }
+	const float* end() const { return data() + size(); }
+};
+
+static inline vector<float>& owned_floats(FloatArray& field) {
+	/**
+	 * field's floats, to change, copied out of its view first if it has one
+	 * */
+	if (field.view != nullptr) {
+		field.owned.assign(field.view, field.view + field.view_size);
+		field.view = nullptr;
+		field.view_size = 0;
+	}
+	return field.owned;
+}
+
+struct PositionArray {
+	/**
+	 * Positions of one kind of scenario object, indexed by 0-indexed id and stored 
+	 * structure-of-arrays so loops over many objects read contiguous memory. 
+	 */ 
+	FloatArray xs; 
+	FloatArray ys; 
+	FloatArray zs;
+
+	// distance from ORIGIN and unit direction from ORIGIN (0 vector for objects at ORIGIN)
+	FloatArray mags; 
+	FloatArray unit_xs; 
+	FloatArray unit_ys; 
+	FloatArray unit_zs;
+};
+
+struct Scenario {
+	PositionArray users; 
+	PositionArray sats; 
+	PositionArray interferers;
+
+	// whatever holds the bytes any of the positions are views of, see load_binary_scenario. Shared, 
+	// so a copy of the scenario (a Planner's, say) keeps them alive too 
+	shared_ptr<const void> backing;
+};
+
+static inline int num_positions(const PositionArray& positions) {
+	return (int) positions.xs.size();
+}
+
+static inline vector_3d_t position_at(const PositionArray& positions, int i) {
+	return {positions.xs[i], positions.ys[i], positions.zs[i]};
+}
+
+static inline void push_position(PositionArray& positions, vector_3d_t pos) {
+	/**
+	 * Append pos, along with its magnitude and unit vector
+	 * */
+	float mag = sqrt(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+	float inv_mag = mag > 0 ? 1.0f / mag : 0.0f;
+	owned_floats(positions.xs).push_back(pos[0]);
+	owned_floats(positions.ys).push_back(pos[1]);
+	owned_floats(positions.zs).push_back(pos[2]);
+	owned_floats(positions.mags).push_back(mag);
+	owned_floats(positions.unit_xs).push_back(pos[0] * inv_mag);
+	owned_floats(positions.unit_ys).push_back(pos[1] * inv_mag);
+	owned_floats(positions.unit_zs).push_back(pos[2] * inv_mag);
+}
+
+static inline void set_position(PositionArray& positions, int i, vector_3d_t pos) {
+	/**
+	 * Move object i to pos, updating its magnitude and unit vector
+	 * */
+	float mag = sqrt(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+	float inv_mag = mag > 0 ? 1.0f / mag : 0.0f;
+	owned_floats(positions.xs)[i] = pos[0];
+	owned_floats(positions.ys)[i] = pos[1];
+	owned_floats(positions.zs)[i] = pos[2];
+	owned_floats(positions.mags)[i] = mag;
+	owned_floats(positions.unit_xs)[i] = pos[0] * inv_mag;
+	owned_floats(positions.unit_ys)[i] = pos[1] * inv_mag;
+	owned_floats(positions.unit_zs)[i] = pos[2] * inv_mag;
+}
+
+// one bit per beam of a sat
+using beam_mask_t = uint64_t;
+
+template <typename Config>
+struct SatBeamEntry {
+	/**
+	 * Keep track of a specific sat's beam usage across all colors. Beams are stored inline 
+	 * in assignment order, beam_targets[i] / beam_dirs[i] for i in [0, total_sat_beam_count)
+	 */ 
+	sat_id_t sat_id; 
+
+	// total beams across all colors for sat_id 
+	int total_sat_beam_count; 
+
+	// user position targeted by each beam, and the unit direction from the sat to it (see beam_dir_of)
+	vector_3d_t beam_targets[Config::beams_per_satellite];
+	vector_3d_t beam_dirs[Config::beams_per_satellite];
+
+	// bit i of color_beams[c] is set if beam i has color c (color_id_of(c))
+	beam_mask_t color_beams[Config::colors_per_satellite];
+};
+
+struct UserVisibilityEntry {
+	user_id_t user_id; 
+
+	// user's visible sats are visible_sat_ids[first_visible_sat, first_visible_sat + num_visible_sats)
+	// in the owning SolveArena 
+	int first_visible_sat; 
+	int num_visible_sats; 
+};
+
+struct BeamAssignment {
+	/**
+	 * One beam of the solution, ids 0-indexed like everywhere else in the solver
+	 */ 
+	sat_id_t sat_id; 
+	user_id_t user_id; 
+
+	// 1-indexed beam number on the sat, and color index, see color_id_of
+	uint8_t beam_id; 
+	uint8_t color_i; 
+};
+
+template <typename Config>
+struct SolveArena {
+	/**
+	 * Owns all of a solve's per-entity state in flat arrays, so a solve makes no per-user or 
+	 * per-sat allocations and tearing it down frees a fixed handful of blocks. Can be reset and 
+	 * reused for the next solve without giving the memory back. 
+	 */ 
+	// one entry per sat, sat_beam_list[i].sat_id = i 
+	vector<SatBeamEntry<Config>> sat_beam_list; 
+
+	// one entry per user, sorted by the solver 
+	vector<UserVisibilityEntry> user_vis_list; 
+
+	// every user's visible sats back to back (CSR), indexed by UserVisibilityEntry 
+	vector<sat_id_t> visible_sat_ids; 
+
+	// unit direction from each visible sat to its user (beam_dir_of), parallel to visible_sat_ids, 
+	// so assignment doesn't redo the geometry visibility already did 
+	vector<vector_3d_t> visible_sat_dirs; 
+
+	// dense form of the lists, see choose_visibility_format: user u's visible sats are the set bits 
+	// of visible_sat_bits[u * sat_words, (u + 1) * sat_words) by sat id, visible_sat_ids and 
+	// visible_sat_dirs are empty, and directions are recomputed when needed (visible_sats_of) 
+	bool dense_visibility; 
+	int sat_words; 
+	vector<uint64_t> visible_sat_bits; 
+
+	// sort_user_vis_list's output buffer, swapped with user_vis_list 
+	vector<UserVisibilityEntry> user_vis_scratch; 
+
+	// # users with each visible sat count, for sort_user_vis_list 
+	vector<int> coverage_counts; 
+
+	// the solution, in the order beams were assigned
+	vector<BeamAssignment> assignments; 
+
+	// bit s % 64 of full_sats[s / 64] is set once assignment has used every beam of sat s, so it's 
+	// skipped without touching its SatBeamEntry. Beams removed afterwards (repair) don't clear it 
+	vector<uint64_t> full_sats; 
+
+	// "score" candidate order only: # users still to be assigned that see each sat 
+	vector<int> sat_demand; 
+};
+
+template <typename Config>
+static inline void reset_arena(SolveArena<Config>& arena) {
+	/**
+	 * Empty the arena for the next solve, keeping its capacity
+	 * */
+	arena.sat_beam_list.clear();
+	arena.user_vis_list.clear();
+	arena.visible_sat_ids.clear();
+	arena.visible_sat_dirs.clear();
+	arena.dense_visibility = false;
+	arena.sat_words = 0;
+	arena.visible_sat_bits.clear();
+	arena.user_vis_scratch.clear();
+	arena.coverage_counts.clear();
+	arena.assignments.clear();
+	arena.full_sats.clear();
+	arena.sat_demand.clear();
+}
+
+#define USER_KEY "user"
+#define SATS_KEY "sat"
+#define INTERFERER_KEY "interferer"
+
+#define MIN(a, b) (a < b ? a : b)
+#define MAX(a, b) (a > b ? a : b)
+
+// float dot products of beam directions within this of cos_self_interference_max are redone 
+// with the exact (double) check, see beams_self_interfere
+#define SELF_INTERFERENCE_COS_MARGIN 1e-4
+
+// lat/long cell size of the satellite grid, and the slack added to every grid query 
+// so float error in the lat/long conversion can never drop a satellite
+#define SAT_GRID_CELL_DEG 5.0
+#define SAT_GRID_QUERY_MARGIN_DEG 1.0
+
+// users per unit of work in the parallel visibility stage
+#define VIS_CHUNK_USERS 1024
+
+struct SatGrid {
+	/**
+	 * Buckets satellites by the lat/long of their direction from ORIGIN, so a user 
+	 * only has to look at satellites within some angular radius of its own direction. 
+	 * 
+	 * Satellites are stored by slot (their index in sat_beam_list), 
+	 * cells are laid out row-major by latitude then longitude. 
+	 */
+	int num_lat_cells; 
+	int num_lon_cells;
+
+	// cell_start[c] .. cell_start[c + 1] is the range of cell_slots belonging to cell c
+	vector<int> cell_start;
+	vector<int> cell_slots;
+
+	// sat positions in cell_slots order, so a run of cells is one contiguous SoA block
+	vector<float> xs;
+	vector<float> ys;
+	vector<float> zs;
+
+	// sats at ORIGIN have no direction, every query has to return them
+	vector<int> unbucketed_slots;
+};
+
+struct SatGridRun {
+	/**
+	 * A contiguous range [begin, end) of SatGrid::cell_slots (and xs / ys / zs)
+	 */
+	int begin;
+	int end;
+};
+
+enum CandidateOrder {
+	/**
+	 * Order assignment tries a user's visible sats in, see SolveOptions::candidate_order
+	 */
+	// sat id order, the reference greedy's
+	CANDIDATE_ORDER_ID,
+	// fewest beams in use first
+	CANDIDATE_ORDER_LOAD,
+	// highest in the user's sky first
+	CANDIDATE_ORDER_ELEVATION,
+	// least contended first: users still to be assigned that see the sat, per free beam
+	CANDIDATE_ORDER_SCORE,
+	NUM_CANDIDATE_ORDERS
+};
+static const char* CANDIDATE_ORDER_NAMES[NUM_CANDIDATE_ORDERS] = {"id", "load", "elevation", "score"};
+
+static inline bool find_candidate_order(const string& name, CandidateOrder* out) {
+	for (int order = 0; order < NUM_CANDIDATE_ORDERS; order ++) {
+		if (name == CANDIDATE_ORDER_NAMES[order]) {
+			*out = (CandidateOrder) order;
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline string candidate_order_names() {
+	string names = "";
+	for (int order = 0; order < NUM_CANDIDATE_ORDERS; order ++) {
+		names += string(order > 0 ? "|" : "") + CANDIDATE_ORDER_NAMES[order];
+	}
+	return names;
+}
+
+// the visibility stage's loop orders: one user at a time against its grid cells, or blocks of 
+// users against tiles of sats
+#define VIS_ORDER_NAMES "user|tiled"
+
+static inline bool is_vis_order(const string& name) {
+	return name == "user" || name == "tiled";
+}
+
+// where the visibility stage's candidate filtering runs, see vis_gpu.h. "gpu" falls back to the 
+// CPU when there's no device or the build has no CUDA; "gpu-host" runs the GPU passes on the host
+#define VIS_BACKEND_NAMES "cpu|gpu|gpu-host"
+
+static inline bool is_vis_backend(const string& name) {
+	return name == "cpu" || name == "gpu" || name == "gpu-host";
+}
+
+// forms the visible sat lists can take after the visibility stage, see choose_visibility_format
+#define VIS_FORMAT_NAMES "auto|csr|bitset"
+
+static inline bool is_vis_format(const string& name) {
+	return name == "auto" || name == "csr" || name == "bitset";
+}
+
+struct SolveOptions {
+	/**
+	 * Knobs for a solve, set from the command line
+	 */ 
+	// threads used by the parallel solver stages
+	int num_threads; 
+
+	// where solve() writes the solution, "" for stdout
+	string output_path; 
+
+	// use the SIMD visibility kernel the CPU supports, instead of the scalar one
+	bool use_simd; 
+
+	// name of the assignment strategy in ASSIGN_STRATEGIES, "greedy" reproduces the serial greedy exactly
+	string assign_strategy; 
+
+	// time the "repair" strategy may spend past the greedy, <= 0 for no limit
+	double assign_budget_ms; 
+
+	// name of the CandidateOrder the strategies try visible sats in, "id" reproduces the reference greedy
+	string candidate_order; 
+
+	// loop order of the visibility stage, one of VIS_ORDER_NAMES, see generate_user_vis_list
+	string vis_order; 
+
+	// form of the visible sat lists, one of VIS_FORMAT_NAMES, see choose_visibility_format
+	string vis_format; 
+
+	// device the visibility stage filters candidates on, one of VIS_BACKEND_NAMES
+	string vis_backend; 
+
+	// name of the constellation config in SOLVER_CONFIGS, "starlink" is evaluate.py's
+	string config; 
+
+	// in a PROFILE build, where solve() writes its profile as JSON, "" for a table on stderr
+	string profile_json_path; 
+
+	// > 0 to stream users this many at a time instead of loading the scenario whole, see 
+	// solve_scenario_streaming, and the directory its spill files go in
+	int stream_chunk_users; 
+	string spill_dir; 
+
+	// overlap parsing with visibility, and writing with assignment, see solve_scenario_pipelined
+	bool pipeline; 
+};
+
+static inline SolveOptions default_solve_options() {
+	SolveOptions options = {};
+	options.num_threads = MAX(1, (int) thread::hardware_concurrency());
+	options.use_simd = true;
+	options.assign_strategy = "greedy";
+	options.candidate_order = "id";
+	options.vis_order = "user";
+	options.vis_format = "auto";
+	options.vis_backend = "cpu";
+	options.config = StarlinkConfig::name;
+	const char* tmp_dir = getenv("TMPDIR");
+	options.spill_dir = tmp_dir != nullptr && tmp_dir[0] != '\0' ? tmp_dir : "/tmp";
+	return options;
+}
+
+inline float calc_angle(vector_3d_t vertex, vector_3d_t point_a, vector_3d_t point_b)
+{
+	/**
+	 * Returns inner angle formed by (point_a -> vertex) and (point_b -> vertex). 
+	 * */
+
+    vector_3d_t va = {point_a[0] - vertex[0], point_a[1] - vertex[1], point_a[2] - vertex[2]};
+    vector_3d_t vb = {point_b[0] - vertex[0], point_b[1] - vertex[1], point_b[2] - vertex[2]};
+
+    float va_mag = sqrt( pow(va[0], 2) + pow(va[1], 2) + pow(va[2], 2));
+    float vb_mag = sqrt( pow(vb[0], 2) + pow(vb[1], 2) + pow(vb[2], 2));
+
+    vector_3d_t va_norm = {va[0] / va_mag, va[1] / va_mag, va[2] / va_mag};
+    vector_3d_t vb_norm = {vb[0] / vb_mag, vb[1] / vb_mag, vb[2] / vb_mag};
+
+    float dot_product = (va_norm[0] * vb_norm[0]) + (va_norm[1] * vb_norm[1]) + (va_norm[2] * vb_norm[2]);
+
+    float dot_product_bound = MIN(1.0, MAX(-1.0, dot_product));
+
+    float angle = acos(dot_product_bound) * 180.0 / 3.141592653589793;
+	return angle;
+}
+
+static inline void lat_long_of(vector_3d_t pos, float* lat, float* lon) {
+	/**
+	 * Latitude and longitude in degrees of pos as seen from ORIGIN, lon in [-180, 180]
+	 * */
+	float xy_mag = sqrt(pos[0] * pos[0] + pos[1] * pos[1]);
+	*lat = RAD_TO_DEG(atan2(pos[2], xy_mag));
+	*lon = RAD_TO_DEG(atan2(pos[1], pos[0]));
+}
+
+static inline int sat_grid_lat_cell(const SatGrid& grid, float lat) {
+	int cell = (int) floor((lat + 90.0) / SAT_GRID_CELL_DEG);
+	return MIN(grid.num_lat_cells - 1, MAX(0, cell));
+}
+
+static inline int sat_grid_lon_cell(const SatGrid& grid, float lon) {
+	int cell = (int) floor((lon + 180.0) / SAT_GRID_CELL_DEG);
+	return MIN(grid.num_lon_cells - 1, MAX(0, cell));
+}
+
+template <typename Config>
+static inline SatGrid build_sat_grid(const Scenario& scenario, const vector<SatBeamEntry<Config>>& sat_beam_list) {
+	/**
+	 * Bucket every satellite in sat_beam_list into a SatGrid (counting sort by cell)
+	 * */
+	SatGrid grid;
+	grid.num_lat_cells = (int) ceil(180.0 / SAT_GRID_CELL_DEG);
+	grid.num_lon_cells = (int) ceil(360.0 / SAT_GRID_CELL_DEG);
+	int num_cells = grid.num_lat_cells * grid.num_lon_cells;
+	int num_slots = (int) sat_beam_list.size();
+
+	// cell of each slot, -1 if unbucketed
+	vector<int> slot_cells(num_slots, -1);
+	grid.cell_start.assign(num_cells + 1, 0);
+	for (int slot = 0; slot < num_slots; slot ++) {
+		sat_id_t sat_id = sat_beam_list[slot].sat_id;
+		if (scenario.sats.mags[sat_id] == 0) {
+			grid.unbucketed_slots.push_back(slot);
+			continue;
+		}
+		float lat, lon;
+		lat_long_of(position_at(scenario.sats, sat_id), &lat, &lon);
+		slot_cells[slot] = sat_grid_lat_cell(grid, lat) * grid.num_lon_cells + sat_grid_lon_cell(grid, lon);
+		grid.cell_start[slot_cells[slot] + 1] += 1;
+	}
+	for (int c = 0; c < num_cells; c ++) {
+		grid.cell_start[c + 1] += grid.cell_start[c];
+	}
+
+	// slots are visited in ascending order, so each cell's slots stay sorted
+	vector<int> fill = grid.cell_start;
+	grid.cell_slots.resize(grid.cell_start[num_cells]);
+	for (int slot = 0; slot < num_slots; slot ++) {
+		if (slot_cells[slot] >= 0) {
+			grid.cell_slots[fill[slot_cells[slot]] ++] = slot;
+		}
+	}
+
+	for (int slot : grid.cell_slots) {
+		sat_id_t sat_id = sat_beam_list[slot].sat_id;
+		grid.xs.push_back(scenario.sats.xs[sat_id]);
+		grid.ys.push_back(scenario.sats.ys[sat_id]);
+		grid.zs.push_back(scenario.sats.zs[sat_id]);
+	}
+	return grid;
+}
+
+static inline void query_sat_grid(const SatGrid& grid, vector_3d_t pos, float radius_deg, vector<SatGridRun>& out_runs) {
+	/**
+	 * Fills out_runs with runs of grid cells covering every bucketed sat whose direction from ORIGIN 
+	 * could be within radius_deg of pos's direction. May cover extra sats, never misses one. 
+	 * Unbucketed sats aren't included. 
+	 * 
+	 * A pos at ORIGIN has no direction and is queried as latitude 0, longitude 0, so only the band 
+	 * around the equator is covered. Users there are the only such queries, and they never see a 
+	 * sat (see append_candidate_sats), so that's harmless. 
+	 * */
+	out_runs.clear();
+
+	float lat, lon;
+	lat_long_of(pos, &lat, &lon);
+	float min_lat = lat - radius_deg;
+	float max_lat = lat + radius_deg; 
+
+	// longitude half-width of the spherical cap, unless the cap covers a pole
+	bool all_lons = (pos[0] == 0 && pos[1] == 0) || max_lat >= 90.0 || min_lat <= -90.0 || radius_deg >= 90.0;
+	float lon_half_width = 180.0;
+	if (!all_lons) {
+		float ratio = sin(DEG_TO_RAD(radius_deg)) / cos(DEG_TO_RAD(lat));
+		all_lons = ratio >= 1.0;
+		if (!all_lons) {
+			lon_half_width = RAD_TO_DEG(asin(ratio));
+		}
+	}
+
+	int lat_cell_lo = sat_grid_lat_cell(grid, min_lat);
+	int lat_cell_hi = sat_grid_lat_cell(grid, max_lat);
+	int lon_cell_lo = 0;
+	int num_lon_span = grid.num_lon_cells;
+	if (!all_lons) {
+		lon_cell_lo = (int) floor((lon - lon_half_width + 180.0) / SAT_GRID_CELL_DEG);
+		int lon_cell_hi = (int) floor((lon + lon_half_width + 180.0) / SAT_GRID_CELL_DEG);
+		num_lon_span = MIN(grid.num_lon_cells, lon_cell_hi - lon_cell_lo + 1);
+	}
+
+	// cells of a lat row are contiguous, so each row is one run, or two if it wraps around the antimeridian
+	int first_lon_cell = ((lon_cell_lo % grid.num_lon_cells) + grid.num_lon_cells) % grid.num_lon_cells;
+	int num_unwrapped = MIN(num_lon_span, grid.num_lon_cells - first_lon_cell);
+	for (int lat_cell = lat_cell_lo; lat_cell <= lat_cell_hi; lat_cell ++) {
+		int row = lat_cell * grid.num_lon_cells;
+		out_runs.push_back({grid.cell_start[row + first_lon_cell], grid.cell_start[row + first_lon_cell + num_unwrapped]});
+		if (num_unwrapped < num_lon_span) {
+			out_runs.push_back({grid.cell_start[row], grid.cell_start[row + num_lon_span - num_unwrapped]});
+		}
+	}
+}
+
+static inline void angle_terms(vector_3d_t vertex, vector_3d_t point_a, vector_3d_t point_b, 
+							   double* dot_product, double* mag_product) {
+	/**
+	 * Dot product of (point_a - vertex) and (point_b - vertex), and the product of their magnitudes, 
+	 * s.t. cos(calc_angle(vertex, point_a, point_b)) = dot_product / mag_product. 
+	 * Done in double like evaluate.py's calculate_angle_degrees, so threshold decisions agree with it. 
+	 * */
+	double va[3] = {(double) point_a[0] - vertex[0], (double) point_a[1] - vertex[1], (double) point_a[2] - vertex[2]};
+	double vb[3] = {(double) point_b[0] - vertex[0], (double) point_b[1] - vertex[1], (double) point_b[2] - vertex[2]};
+	double va_mag_sq = va[0] * va[0] + va[1] * va[1] + va[2] * va[2];
+	double vb_mag_sq = vb[0] * vb[0] + vb[1] * vb[1] + vb[2] * vb[2];
+	*dot_product = va[0] * vb[0] + va[1] * vb[1] + va[2] * vb[2];
+	*mag_product = sqrt(va_mag_sq * vb_mag_sq);
+	PROFILE_COUNT(PROFILE_ANGLE_CHECKS);
+}
+
+static inline bool angle_less_than(vector_3d_t vertex, vector_3d_t point_a, vector_3d_t point_b, double cos_threshold) {
+	/**
+	 * calc_angle(vertex, point_a, point_b) < threshold, where cos_threshold = cos(threshold)
+	 * */
+	double dot_product, mag_product;
+	angle_terms(vertex, point_a, point_b, &dot_product, &mag_product);
+	return dot_product > cos_threshold * mag_product;
+}
+
+static inline bool angle_at_most(vector_3d_t vertex, vector_3d_t point_a, vector_3d_t point_b, double cos_threshold) {
+	/**
+	 * calc_angle(vertex, point_a, point_b) <= threshold, where cos_threshold = cos(threshold)
+	 * */
+	double dot_product, mag_product;
+	angle_terms(vertex, point_a, point_b, &dot_product, &mag_product);
+	return dot_product >= cos_threshold * mag_product;
+}
+
+template <typename Config>
+static inline bool angle_violates(vector_3d_t vertex, vector_3d_t point_a, vector_3d_t point_b, double cos_threshold, bool or_equal) {
+	/**
+	 * The solver's side of angle_less_than (angle_at_most if or_equal), where true means the constraint 
+	 * is violated: angles up to Config::boundary_guard_cos (in cosine) past the threshold count too. 
+	 * */
+	double dot_product, mag_product;
+	angle_terms(vertex, point_a, point_b, &dot_product, &mag_product);
+	double bound = (cos_threshold - Config::boundary_guard_cos) * mag_product;
+	return or_equal ? dot_product >= bound : dot_product > bound;
+}
+
+static inline vector_3d_t beam_dir_of(vector_3d_t sat_pos, vector_3d_t user_pos) {
+	/**
+	 * Unit direction from sat_pos to user_pos, the 0 vector if they're the same point
+	 * */
+	float d[3] = {user_pos[0] - sat_pos[0], user_pos[1] - sat_pos[1], user_pos[2] - sat_pos[2]};
+	float mag = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	float inv_mag = mag > 0 ? 1.0f / mag : 0.0f;
+	return {d[0] * inv_mag, d[1] * inv_mag, d[2] * inv_mag};
+}
+
+template <typename Config>
+static inline bool beams_self_interfere(vector_3d_t sat_pos, vector_3d_t user_a, const vector_3d_t& dir_a, 
+										vector_3d_t user_b, const vector_3d_t& dir_b) {
+	/**
+	 * angle_less_than(sat_pos, user_a, user_b, Config::cos_self_interference_max), given the beams' directions 
+	 * from beam_dir_of. Almost always decided by their dot product alone. 
+	 * */
+	PROFILE_COUNT(PROFILE_SELF_INTERFERENCE_TESTS);
+	float cos_angle = dir_a[0] * dir_b[0] + dir_a[1] * dir_b[1] + dir_a[2] * dir_b[2];
+	if (cos_angle > Config::cos_self_interference_max + SELF_INTERFERENCE_COS_MARGIN) {
+		return true;
+	}
+	if (cos_angle <= Config::cos_self_interference_max - SELF_INTERFERENCE_COS_MARGIN) {
+		return false;
+	}
+	PROFILE_COUNT(PROFILE_SELF_INTERFERENCE_EXACT_CHECKS);
+	return angle_violates<Config>(sat_pos, user_a, user_b, Config::cos_self_interference_max, false);
+}
+
+struct VisQuery {
+	/**
+	 * A user set up for the visibility mask kernels. With u the user position and v = s - u for 
+	 * sat position s, the kernels flag s when dot(u, v) > 0 and dot(u, v)^2 > cos_sq_uu * |v|^2, 
+	 * where cos_sq_uu = (cos(cone_deg) - VIS_KERNEL_COS_MARGIN)^2 * |u|^2, see vis_query_of. 
+	 */
+	float ux, uy, uz;
+	float cos_sq_uu;
+};
+
+// kernels compare against a cosine relaxed by this much, so float error can only add sats 
+// to the mask. Flagged sats still go through the exact (double) visibility check
+#define VIS_KERNEL_COS_MARGIN 1e-3
+
+static inline VisQuery vis_query_of(vector_3d_t user_pos, float cone_deg) {
+	/**
+	 * Query flagging sats within cone_deg of the user's zenith, max_user_visible_angle for the 
+	 * visibility constraint itself 
+	 * */
+	float cos_relaxed = cos(DEG_TO_RAD(cone_deg)) - VIS_KERNEL_COS_MARGIN;
+	float uu = user_pos[0] * user_pos[0] + user_pos[1] * user_pos[1] + user_pos[2] * user_pos[2];
+	return {user_pos[0], user_pos[1], user_pos[2], cos_relaxed * cos_relaxed * uu};
+}
+
+// sets bit i of out_mask (32 sats per word, ceil(count / 32) words) if sat i of the SoA 
+// block xs / ys / zs [0, count) may be visible to query
+using vis_mask_kernel_t = void (*)(const float* xs, const float* ys, const float* zs, int count, 
+								   const VisQuery& query, uint32_t* out_mask);
+
+static inline void vis_mask_range(const float* xs, const float* ys, const float* zs, int begin, int end, 
+								  const VisQuery& query, uint32_t* out_mask) {
+	/**
+	 * Sets the out_mask bits of sats [begin, end) one at a time, finishes the tail of the SIMD kernels
+	 * */
+	for (int i = begin; i < end; i ++) {
+		float vx = xs[i] - query.ux, vy = ys[i] - query.uy, vz = zs[i] - query.uz;
+		float d = query.ux * vx + query.uy * vy + query.uz * vz;
+		float vv = vx * vx + vy * vy + vz * vz;
+		if (d > 0 && d * d > query.cos_sq_uu * vv) {
+			out_mask[i >> 5] |= 1u << (i & 31);
+		}
+	}
+}
+
+static inline void vis_mask_scalar(const float* xs, const float* ys, const float* zs, int count, 
+								   const VisQuery& query, uint32_t* out_mask) {
+	/**
+	 * Portable vis_mask_kernel_t
+	 * */
+	memset(out_mask, 0, ((count + 31) / 32) * sizeof(uint32_t));
+	vis_mask_range(xs, ys, zs, 0, count, query, out_mask);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static inline void vis_mask_avx2(const float* xs, const float* ys, const float* zs, int count, 
+								 const VisQuery& query, uint32_t* out_mask) {
+	/**
+	 * vis_mask_kernel_t over 8 sats at a time, picked at runtime on CPUs with AVX2 + FMA
+	 * */
+	memset(out_mask, 0, ((count + 31) / 32) * sizeof(uint32_t));
+	int num_blocks = count / 8;
+	const __m256 ux = _mm256_set1_ps(query.ux), uy = _mm256_set1_ps(query.uy), uz = _mm256_set1_ps(query.uz);
+	const __m256 cos_sq_uu = _mm256_set1_ps(query.cos_sq_uu);
+	const __m256 zero = _mm256_setzero_ps();
+	for (int block = 0; block < num_blocks; block ++) {
+		int i = block * 8;
+		__m256 vx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), ux);
+		__m256 vy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), uy);
+		__m256 vz = _mm256_sub_ps(_mm256_loadu_ps(zs + i), uz);
+		__m256 d = _mm256_fmadd_ps(uz, vz, _mm256_fmadd_ps(uy, vy, _mm256_mul_ps(ux, vx)));
+		__m256 vv = _mm256_fmadd_ps(vz, vz, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vx, vx)));
+		__m256 flagged = _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_GT_OQ), 
+									   _mm256_cmp_ps(_mm256_mul_ps(d, d), _mm256_mul_ps(cos_sq_uu, vv), _CMP_GT_OQ));
+		out_mask[i >> 5] |= (uint32_t) _mm256_movemask_ps(flagged) << (i & 31);
+	}
+	vis_mask_range(xs, ys, zs, num_blocks * 8, count, query, out_mask);
+}
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+static inline void vis_mask_neon(const float* xs, const float* ys, const float* zs, int count, 
+								 const VisQuery& query, uint32_t* out_mask) {
+	/**
+	 * vis_mask_kernel_t over 4 sats at a time, NEON is always there on aarch64
+	 * */
+	memset(out_mask, 0, ((count + 31) / 32) * sizeof(uint32_t));
+	const float32x4_t ux = vdupq_n_f32(query.ux), uy = vdupq_n_f32(query.uy), uz = vdupq_n_f32(query.uz);
+	const float32x4_t cos_sq_uu = vdupq_n_f32(query.cos_sq_uu);
+	const float32x4_t zero = vdupq_n_f32(0);
+	const uint32_t lane_bit_values[4] = {1, 2, 4, 8};
+	const uint32x4_t lane_bits = vld1q_u32(lane_bit_values);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t vx = vsubq_f32(vld1q_f32(xs + i), ux);
+		float32x4_t vy = vsubq_f32(vld1q_f32(ys + i), uy);
+		float32x4_t vz = vsubq_f32(vld1q_f32(zs + i), uz);
+		float32x4_t d = vfmaq_f32(vfmaq_f32(vmulq_f32(ux, vx), uy, vy), uz, vz);
+		float32x4_t vv = vfmaq_f32(vfmaq_f32(vmulq_f32(vx, vx), vy, vy), vz, vz);
+		uint32x4_t flagged = vandq_u32(vcgtq_f32(d, zero), vcgtq_f32(vmulq_f32(d, d), vmulq_f32(cos_sq_uu, vv)));
+		out_mask[i >> 5] |= vaddvq_u32(vandq_u32(flagged, lane_bits)) << (i & 31);
+	}
+	vis_mask_range(xs, ys, zs, i, count, query, out_mask);
+}
+#endif
+
+static inline vis_mask_kernel_t select_vis_mask_kernel(bool use_simd) {
+	/**
+	 * Best visibility mask kernel this CPU can run, or the scalar one if !use_simd
+	 * */
+	if (!use_simd) {
+		return vis_mask_scalar;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return vis_mask_avx2;
+	}
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	return vis_mask_neon;
+#endif
+	return vis_mask_scalar;
+}
+
+template <typename chunk_fn_t>
+static inline void parallel_for_chunks(int num_chunks, int num_threads, chunk_fn_t chunk_fn) {
+	/**
+	 * Calls chunk_fn(chunk_i) for each chunk_i in [0, num_chunks) using up to num_threads threads, 
+	 * the calling thread included. Chunks are handed out dynamically, so which thread runs a 
+	 * chunk is not deterministic; chunk_fn must only write state owned by its chunk. 
+	 * */
+	atomic<int> next_chunk(0);
+	auto worker = [&]() {
+		for (int chunk_i = next_chunk++; chunk_i < num_chunks; chunk_i = next_chunk++) {
+			chunk_fn(chunk_i);
+		}
+	};
+
+	int num_spawned = MIN(num_threads, num_chunks) - 1;
+	vector<thread> threads = {};
+	for (int i = 0; i < num_spawned; i ++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (thread& t : threads) {
+		t.join();
+	}
+}
+
+struct MappedFile {
+	/**
+	 * Read-only mmap of a whole file
+	 */ 
+	const char* data; 
+	size_t size; 
+};
+
+static inline bool map_file(const string& filename, MappedFile* out) {
+	/**
+	 * mmap filename into out, returns false if it can't be opened. An empty file maps to 
+	 * {nullptr, 0} without calling mmap. 
+	 * */
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		return false;
+	}
+	out->data = nullptr;
+	out->size = (size_t) file_stat.st_size;
+	if (out->size > 0) {
+		void* data = mmap(nullptr, out->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			return false;
+		}
+		madvise(data, out->size, MADV_SEQUENTIAL);
+		out->data = (const char*) data;
+	}
+	// the mapping stays valid after the fd is closed
+	close(fd);
+	return true;
+}
+
+static inline void unmap_file(MappedFile& file) {
+	if (file.size > 0) {
+		munmap((void*) file.data, file.size);
+	}
+	file = {nullptr, 0};
+}
+
+static inline shared_ptr<const void> share_mapping(const MappedFile& file) {
+	/**
+	 * Owner of file's mapping, which is unmapped once the last copy of it is dropped
+	 * */
+	return shared_ptr<const MappedFile>(new MappedFile(file), [](const MappedFile* mapping) {
+		MappedFile unmapping = *mapping;
+		unmap_file(unmapping);
+		delete mapping;
+	});
+}
+
+template <typename float_t>
+static inline bool parse_float(string_view token, float_t* out) {
+	/**
+	 * Parse the float (or double) at the start of token like stof (stod) does; a leading '+' is 
+	 * allowed and trailing characters are ignored. Returns false if token doesn't start with one. 
+	 * */
+	const char* first = token.data();
+	const char* last = first + token.size();
+	if (first != last && *first == '+') {
+		first ++;
+	}
+#if defined(__cpp_lib_to_chars)
+	return from_chars(first, last, *out).ec == errc();
+#else
+	// libstdc++ before 11 has no floating point from_chars, strtof a NUL-terminated copy
+	char buff[64];
+	size_t len = MIN(sizeof(buff) - 1, (size_t) (last - first));
+	memcpy(buff, first, len);
+	buff[len] = '\0';
+	char* end;
+	if constexpr (is_same<float_t, float>::value) {
+		*out = strtof(buff, &end);
+	} else {
+		*out = strtod(buff, &end);
+	}
+	return end != buff;
+#endif
+}
+
+static inline bool parse_int(string_view token, int* out) {
+	/**
+	 * Parse the int at the start of token like stoi does, see parse_float
+	 * */
+	const char* first = token.data();
+	const char* last = first + token.size();
+	if (first != last && *first == '+') {
+		first ++;
+	}
+	return from_chars(first, last, *out).ec == errc();
+}
+
+template <typename coord_t = float, typename line_fn_t>
+static inline bool parse_scenario_lines(const char* data, size_t size, line_fn_t line_fn) {
+	/**
+	 * Parse the scenario text in [data, data + size) in place, calling line_fn(type, id, pos) 
+	 * for each object line in order, pos an array<coord_t, 3>: the solver's vector_3d_t by default, 
+	 * or double for the validator. 
+	 * 
+	 * Lines that are empty or start with '#' are skipped. Every other line must be exactly 
+	 * 5 single-space separated fields, "<type> <id> <x> <y> <z>". On a bad line prints it 
+	 * and returns false. 
+	 * */
+	const char* end = data + size;
+	const char* line_start = data;
+	while (line_start < end) {
+		const char* line_end = (const char*) memchr(line_start, '\n', end - line_start);
+		if (line_end == nullptr) {
+			line_end = end;
+		}
+		string_view line(line_start, line_end - line_start);
+		line_start = line_end + 1;
+
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		// split on single spaces, counting every field but keeping only the first 5
+		string_view parts[5];
+		int num_parts = 0;
+		size_t part_start = 0;
+		while (true) {
+			size_t part_end = line.find(' ', part_start);
+			if (num_parts < 5) {
+				parts[num_parts] = line.substr(part_start, part_end == string_view::npos ? string_view::npos : part_end - part_start);
+			}
+			num_parts ++;
+			if (part_end == string_view::npos) {
+				break;
+			}
+			part_start = part_end + 1;
+		}
+
+		array<coord_t, 3> pos;
+		int id;
+		if (num_parts != 5 || !parse_int(parts[1], &id) || !parse_float(parts[2], &pos[0]) 
+			|| !parse_float(parts[3], &pos[1]) || !parse_float(parts[4], &pos[2])) {
+			cout << "couldn't read line!";
+			cout << line;
+			return false;
+		}
+		assert(parts[0] == USER_KEY || parts[0] == SATS_KEY || parts[0] == INTERFERER_KEY);
+		line_fn(parts[0], id, pos);
+	}
+	return true;
+}
+
+template <typename Config>
+static inline bool parse_scenario(const char* data, size_t size, Scenario& scenario, vector<SatBeamEntry<Config>>& sat_beam_list) {
+	/**
+	 * Parse the scenario text in [data, data + size), appending to scenario and adding a 
+	 * SatBeamEntry for each sat to sat_beam_list, see parse_scenario_lines 
+	 * */
+	return parse_scenario_lines(data, size, [&](string_view type, int id, vector_3d_t pos) {
+		// add to scenario
+		if (type == USER_KEY) {
+			push_position(scenario.users, pos);
+		} else if (type == SATS_KEY) {
+			push_position(scenario.sats, pos);
+
+			// add sat to sat beam list 
+			SatBeamEntry<Config> entry = {};
+			entry.sat_id = id - 1;
+			sat_beam_list.push_back(entry); 
+		} else if (type == INTERFERER_KEY) {
+			push_position(scenario.interferers, pos);
+		}
+	});
+}
+
+// binary scenarios start with BINARY_SCENARIO_MAGIC, see BinaryScenarioHeader
+#define BINARY_SCENARIO_MAGIC "BEAMSCN"
+#define BINARY_SCENARIO_VERSION 1
+#define BINARY_SCENARIO_BYTE_ORDER 0x01020304u
+#define BINARY_SCENARIO_ALIGN 64
+
+struct BinaryScenarioHeader {
+	/**
+	 * Start of a binary scenario. The header is padded to BINARY_SCENARIO_ALIGN bytes and followed, 
+	 * for users, sats then interferers, by the 7 arrays of their PositionArray (xs, ys, zs, mags, 
+	 * unit_xs, unit_ys, unit_zs) as native floats, each padded to a BINARY_SCENARIO_ALIGN multiple. 
+	 * Ids are implicit, object i has id i + 1. 
+	 */
+	char magic[8];
+	uint32_t version;
+
+	// BINARY_SCENARIO_BYTE_ORDER as written, so a file from a machine of the other endianness is rejected
+	uint32_t byte_order;
+
+	uint32_t num_users;
+	uint32_t num_sats;
+	uint32_t num_interferers;
+	uint32_t reserved;
+};
+static_assert(sizeof(BinaryScenarioHeader) <= BINARY_SCENARIO_ALIGN, "header must fit its padding");
+
+#define POSITION_ARRAY_FIELDS 7
+
+static inline array<FloatArray*, POSITION_ARRAY_FIELDS> position_fields(PositionArray& positions) {
+	return {&positions.xs, &positions.ys, &positions.zs, &positions.mags, 
+			&positions.unit_xs, &positions.unit_ys, &positions.unit_zs};
+}
+
+static inline array<const FloatArray*, POSITION_ARRAY_FIELDS> position_fields(const PositionArray& positions) {
+	return {&positions.xs, &positions.ys, &positions.zs, &positions.mags, 
+			&positions.unit_xs, &positions.unit_ys, &positions.unit_zs};
+}
+
+static inline void clear_positions(PositionArray& positions) {
+	/**
+	 * Empty positions, dropping any views, keeping owned capacity
+	 * */
+	for (FloatArray* field : position_fields(positions)) {
+		field->owned.clear();
+		field->view = nullptr;
+		field->view_size = 0;
+	}
+}
+
+static inline void resize_positions(PositionArray& positions, int count) {
+	for (FloatArray* field : position_fields(positions)) {
+		owned_floats(*field).resize(count);
+	}
+}
+
+static inline void clear_scenario(Scenario& scenario) {
+	/**
+	 * Empty scenario for the next load, keeping its capacity and releasing what its views held
+	 * */
+	clear_positions(scenario.users);
+	clear_positions(scenario.sats);
+	clear_positions(scenario.interferers);
+	scenario.backing.reset();
+}
+
+static inline size_t binary_scenario_array_bytes(uint32_t count) {
+	return ((size_t) count * sizeof(float) + BINARY_SCENARIO_ALIGN - 1) / BINARY_SCENARIO_ALIGN * BINARY_SCENARIO_ALIGN;
+}
+
+static inline bool is_binary_scenario(const char* data, size_t size) {
+	return size >= sizeof(BinaryScenarioHeader) && memcmp(data, BINARY_SCENARIO_MAGIC, sizeof(BINARY_SCENARIO_MAGIC)) == 0;
+}
+
+static inline void format_binary_scenario(const Scenario& scenario, string& out_data) {
+	/**
+	 * Write scenario as a binary scenario into out_data, see BinaryScenarioHeader
+	 * */
+	BinaryScenarioHeader header = {};
+	memcpy(header.magic, BINARY_SCENARIO_MAGIC, sizeof(BINARY_SCENARIO_MAGIC));
+	header.version = BINARY_SCENARIO_VERSION;
+	header.byte_order = BINARY_SCENARIO_BYTE_ORDER;
+	header.num_users = (uint32_t) num_positions(scenario.users);
+	header.num_sats = (uint32_t) num_positions(scenario.sats);
+	header.num_interferers = (uint32_t) num_positions(scenario.interferers);
+
+	const PositionArray* kinds[3] = {&scenario.users, &scenario.sats, &scenario.interferers};
+	size_t size = BINARY_SCENARIO_ALIGN;
+	for (const PositionArray* positions : kinds) {
+		size += POSITION_ARRAY_FIELDS * binary_scenario_array_bytes((uint32_t) num_positions(*positions));
+	}
+
+	// zero filled, so the padding is too
+	out_data.assign(size, '\0');
+	memcpy(&out_data[0], &header, sizeof(header));
+	size_t offset = BINARY_SCENARIO_ALIGN;
+	for (const PositionArray* positions : kinds) {
+		uint32_t count = (uint32_t) num_positions(*positions);
+		for (const FloatArray* field : position_fields(*positions)) {
+			if (count > 0) {
+				memcpy(&out_data[offset], field->data(), count * sizeof(float));
+			}
+			offset += binary_scenario_array_bytes(count);
+		}
+	}
+}
+
+template <typename Config>
+static inline bool load_binary_scenario(const char* data, size_t size, Scenario& scenario, vector<SatBeamEntry<Config>>& sat_beam_list, 
+										shared_ptr<const void> backing = nullptr) {
+	/**
+	 * Load the binary scenario in [data, data + size), appending to scenario and adding a 
+	 * SatBeamEntry for each sat to sat_beam_list like parse_scenario. Nothing is parsed. Given 
+	 * the backing that keeps data alive (see share_mapping), an empty scenario is loaded as views 
+	 * of the file's arrays, holding backing, so loading takes no copies at all; otherwise each 
+	 * array is one bulk copy. Returns false (after saying why) if the file isn't one this build 
+	 * can read. 
+	 * */
+	BinaryScenarioHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.version != BINARY_SCENARIO_VERSION || header.byte_order != BINARY_SCENARIO_BYTE_ORDER) {
+		cout << "unsupported binary scenario version or byte order" << endl;
+		return false;
+	}
+
+	PositionArray* kinds[3] = {&scenario.users, &scenario.sats, &scenario.interferers};
+	uint32_t counts[3] = {header.num_users, header.num_sats, header.num_interferers};
+	size_t expected_size = BINARY_SCENARIO_ALIGN;
+	for (uint32_t count : counts) {
+		expected_size += POSITION_ARRAY_FIELDS * binary_scenario_array_bytes(count);
+	}
+	if (size < expected_size) {
+		cout << "binary scenario is truncated" << endl;
+		return false;
+	}
+
+	// the arrays are BINARY_SCENARIO_ALIGN aligned from data, so from any float aligned data 
+	bool view = backing != nullptr && (uintptr_t) data % alignof(float) == 0 && scenario.backing == nullptr 
+		&& num_positions(scenario.users) == 0 && num_positions(scenario.sats) == 0 && num_positions(scenario.interferers) == 0;
+	if (view) {
+		scenario.backing = backing;
+	}
+	size_t offset = BINARY_SCENARIO_ALIGN;
+	for (int kind_i = 0; kind_i < 3; kind_i ++) {
+		size_t count = counts[kind_i];
+		for (FloatArray* field : position_fields(*kinds[kind_i])) {
+			if (view) {
+				field->owned.clear();
+				field->view = (const float*) (data + offset);
+				field->view_size = count;
+				offset += binary_scenario_array_bytes(counts[kind_i]);
+				continue;
+			}
+			vector<float>& floats = owned_floats(*field);
+			size_t first = floats.size();
+			floats.resize(first + count);
+			if (count > 0) {
+				memcpy(floats.data() + first, data + offset, count * sizeof(float));
+			}
+			offset += binary_scenario_array_bytes(counts[kind_i]);
+		}
+	}
+
+	int first_sat = (int) sat_beam_list.size();
+	for (uint32_t sat_i = 0; sat_i < header.num_sats; sat_i ++) {
+		SatBeamEntry<Config> entry = {};
+		entry.sat_id = first_sat + (int) sat_i;
+		sat_beam_list.push_back(entry);
+	}
+	return true;
+}
+
+template <typename Config>
+static inline bool load_scenario(const char* data, size_t size, Scenario& scenario, vector<SatBeamEntry<Config>>& sat_beam_list, 
+								 shared_ptr<const void> backing = nullptr) {
+	/**
+	 * Load a scenario in either format, binary (see is_binary_scenario) or text. A binary one is 
+	 * viewed in place given backing, see load_binary_scenario. 
+	 * */
+	if (is_binary_scenario(data, size)) {
+		return load_binary_scenario(data, size, scenario, sat_beam_list, backing);
+	}
+	return parse_scenario(data, size, scenario, sat_beam_list);
+}
+
+template <typename Config>
+static inline int find_beam_color(const SatBeamEntry<Config>& beam_entry, vector_3d_t sat_pos, vector_3d_t user_pos, const vector_3d_t& user_dir) {
+	/**
+	 * First color a new beam from sat_pos to user_pos (in direction user_dir) could take without 
+	 * self interfering with beam_entry's beams of that color, or -1 if there's none 
+	 * */
+	PROFILE_COUNT(PROFILE_ASSIGN_COLOR_SCANS);
+	// the trip count is a compile time constant, unrolled into one straight run of colors
+#pragma GCC unroll 32
+	for (int color_i = 0; color_i < Config::colors_per_satellite; color_i ++) {
+		// iterate over current beams in color, see if any conflict. 
+		// if no conflict, good to assign to beam! 
+		bool self_interference = false;
+		for (beam_mask_t beams = beam_entry.color_beams[color_i]; beams != 0; beams &= beams - 1) {
+			int beam_i = __builtin_ctzll(beams);
+			if (beams_self_interfere<Config>(sat_pos, user_pos, user_dir, beam_entry.beam_targets[beam_i], beam_entry.beam_dirs[beam_i])) {
+				self_interference = true; 
+				break;
+			}
+		}
+		if (!self_interference) {
+			return color_i;
+		}
+	}
+	PROFILE_COUNT(PROFILE_ASSIGN_COLOR_FAILURES);
+	return -1;
+}
+
+struct VisibleSats {
+	/**
+	 * One user's visible sats in sat id order and the beam_dir_of direction from each to the user, 
+	 * see visible_sats_of 
+	 */
+	const sat_id_t* ids; 
+	const vector_3d_t* dirs; 
+	int count; 
+};
+
+struct VisibleSatsScratch {
+	/**
+	 * Where visible_sats_of decodes a dense user, reused across users 
+	 */
+	vector<sat_id_t> ids; 
+	vector<vector_3d_t> dirs; 
+};
+
+template <typename Config>
+static inline const sat_id_t* visible_sat_ids_of(const SolveArena<Config>& arena, const UserVisibilityEntry& entry, 
+												 VisibleSatsScratch& scratch) {
+	/**
+	 * The ids of entry's visible sats, decoded into scratch.ids if the arena is dense 
+	 * */
+	if (!arena.dense_visibility) {
+		return arena.visible_sat_ids.data() + entry.first_visible_sat;
+	}
+	scratch.ids.clear();
+	const uint64_t* row = &arena.visible_sat_bits[(size_t) entry.user_id * arena.sat_words];
+	for (int word_i = 0; word_i < arena.sat_words; word_i ++) {
+		for (uint64_t bits = row[word_i]; bits != 0; bits &= bits - 1) {
+			scratch.ids.push_back(word_i * 64 + __builtin_ctzll(bits));
+		}
+	}
+	return scratch.ids.data();
+}
+
+template <typename Config>
+static inline VisibleSats visible_sats_of(const Scenario& scenario, const SolveArena<Config>& arena, const UserVisibilityEntry& entry, 
+										  VisibleSatsScratch& scratch) {
+	/**
+	 * entry's visible sats and their directions, either form. A dense user's are decoded into 
+	 * scratch, so they're only valid until its next use. 
+	 * */
+	const sat_id_t* ids = visible_sat_ids_of(arena, entry, scratch);
+	if (!arena.dense_visibility) {
+		return {ids, arena.visible_sat_dirs.data() + entry.first_visible_sat, entry.num_visible_sats};
+	}
+	vector_3d_t user_pos = position_at(scenario.users, entry.user_id);
+	scratch.dirs.resize(entry.num_visible_sats);
+	for (int sat_list_i = 0; sat_list_i < entry.num_visible_sats; sat_list_i ++) {
+		scratch.dirs[sat_list_i] = beam_dir_of(position_at(scenario.sats, ids[sat_list_i]), user_pos);
+	}
+	return {ids, scratch.dirs.data(), entry.num_visible_sats};
+}
+
+template <typename Config>
+static inline void choose_visibility_format(const SolveOptions& options, SolveArena<Config>& arena) {
+	/**
+	 * Pick the form of the visible sat lists generate_user_vis_list just built, per options.vis_format. 
+	 * "auto" measures their density and switches to the dense form when a bitset per user over the 
+	 * sats is smaller than the sparse lists, ids and cached directions (16 bytes a visible sat): 
+	 * a mean of more than sat_words / 2 visible sats per user, e.g. a share over 1 / 128 of the sats. 
+	 * The dense form's count of each user is the popcount of its row, which sort_user_vis_list keys on. 
+	 * */
+	size_t num_users = arena.user_vis_list.size();
+	int sat_words = (int) ((arena.sat_beam_list.size() + 63) / 64);
+	size_t csr_bytes = arena.visible_sat_ids.size() * (sizeof(sat_id_t) + sizeof(vector_3d_t));
+	size_t bitset_bytes = num_users * sat_words * sizeof(uint64_t);
+	bool dense = options.vis_format == "bitset" || (options.vis_format == "auto" && bitset_bytes < csr_bytes);
+	if (!dense) {
+		return;
+	}
+
+	arena.sat_words = sat_words;
+	arena.visible_sat_bits.assign(num_users * sat_words, 0);
+	for (UserVisibilityEntry& entry : arena.user_vis_list) {
+		uint64_t* row = &arena.visible_sat_bits[(size_t) entry.user_id * sat_words];
+		for (int sat_list_i = 0; sat_list_i < entry.num_visible_sats; sat_list_i ++) {
+			sat_id_t sat_i = arena.visible_sat_ids[entry.first_visible_sat + sat_list_i];
+			row[sat_i / 64] |= (uint64_t) 1 << (sat_i % 64);
+		}
+		int popcount = 0;
+		for (int word_i = 0; word_i < sat_words; word_i ++) {
+			popcount += __builtin_popcountll(row[word_i]);
+		}
+		entry.num_visible_sats = popcount;
+		entry.first_visible_sat = -1;
+	}
+	arena.dense_visibility = true;
+
+	// give the sparse lists' memory back, that's the point
+	vector<sat_id_t>().swap(arena.visible_sat_ids);
+	vector<vector_3d_t>().swap(arena.visible_sat_dirs);
+}
+
+struct CandidateRanking {
+	/**
+	 * How assign_user_beam orders and prunes a user's visible sats. full_sats and sat_demand point 
+	 * into the arena (SolveArena::full_sats, SolveArena::sat_demand, nullptr unless the order is 
+	 * "score") and are shared by every thread assigning into it; ranked is per thread scratch. 
+	 */
+	CandidateOrder order; 
+	uint64_t* full_sats; 
+	int* sat_demand; 
+
+	// (key, index into the user's visible sats) of its sats that aren't full, ascending key
+	vector<pair<float, int>> ranked; 
+};
+
+static inline bool sat_is_full(const uint64_t* full_sats, sat_id_t sat_i) {
+	return (__atomic_load_n(&full_sats[sat_i / 64], __ATOMIC_RELAXED) >> (sat_i % 64)) & 1;
+}
+
+static inline void mark_sat_full(uint64_t* full_sats, sat_id_t sat_i) {
+	// parallel-ordered's bands own disjoint sats, but they can share a word
+	__atomic_fetch_or(&full_sats[sat_i / 64], (uint64_t) 1 << (sat_i % 64), __ATOMIC_RELAXED);
+}
+
+template <typename Config>
+static inline CandidateRanking prepare_candidate_ranking(SolveArena<Config>& arena, CandidateOrder order) {
+	/**
+	 * A ranking for assigning arena.user_vis_list. Sizes arena.full_sats to the sats, keeping any bits 
+	 * already set, and for the "score" order adds user_vis_list's users to arena.sat_demand. Call once 
+	 * per user_vis_list; each thread then works on its own copy. 
+	 * */
+	size_t num_sats = arena.sat_beam_list.size();
+	arena.full_sats.resize((num_sats + 63) / 64, 0);
+	CandidateRanking ranking = {};
+	ranking.order = order;
+	ranking.full_sats = arena.full_sats.data();
+	ranking.sat_demand = nullptr;
+	if (order == CANDIDATE_ORDER_SCORE) {
+		arena.sat_demand.resize(num_sats, 0);
+		VisibleSatsScratch scratch;
+		for (const UserVisibilityEntry& entry : arena.user_vis_list) {
+			const sat_id_t* visible_sats = visible_sat_ids_of(arena, entry, scratch);
+			for (int sat_list_i = 0; sat_list_i < entry.num_visible_sats; sat_list_i ++) {
+				arena.sat_demand[visible_sats[sat_list_i]] += 1;
+			}
+		}
+		ranking.sat_demand = arena.sat_demand.data();
+	}
+	return ranking;
+}
+
+template <typename Config>
+static inline void rank_candidates(const Scenario& scenario, const vector<SatBeamEntry<Config>>& sat_beam_list, 
+								   CandidateRanking& ranking, const UserVisibilityEntry& user_entry, 
+								   const sat_id_t* visible_sats, const vector_3d_t* visible_sat_dirs) {
+	/**
+	 * Fill ranking.ranked with the user's sats that aren't full, stably sorted by the order's key 
+	 * as things stand now. Lists are a few dozen sats, so an insertion sort. 
+	 * */
+	user_id_t user_i = user_entry.user_id;
+	vector<pair<float, int>>& ranked = ranking.ranked;
+	ranked.clear();
+	for (int sat_list_i = 0; sat_list_i < user_entry.num_visible_sats; sat_list_i ++) {
+		sat_id_t sat_i = visible_sats[sat_list_i];
+		if (sat_is_full(ranking.full_sats, sat_i)) {
+			PROFILE_COUNT(PROFILE_ASSIGN_SAT_FULL);
+			continue;
+		}
+		float key = 0;
+		int num_free_beams = Config::beams_per_satellite - sat_beam_list[sat_i].total_sat_beam_count;
+		if (ranking.order == CANDIDATE_ORDER_LOAD) {
+			key = (float) -num_free_beams;
+		} else if (ranking.order == CANDIDATE_ORDER_ELEVATION) {
+			// the beam points from the sat down to the user, the more it's against the user's up the higher the sat
+			const vector_3d_t& dir = visible_sat_dirs[sat_list_i];
+			key = dir[0] * scenario.users.unit_xs[user_i] + dir[1] * scenario.users.unit_ys[user_i] 
+				+ dir[2] * scenario.users.unit_zs[user_i];
+		} else if (ranking.order == CANDIDATE_ORDER_SCORE) {
+			key = (float) ranking.sat_demand[sat_i] / num_free_beams;
+		}
+		int rank_i = (int) ranked.size();
+		ranked.push_back({key, sat_list_i});
+		for (; rank_i > 0 && ranked[rank_i - 1].first > key; rank_i --) {
+			ranked[rank_i] = ranked[rank_i - 1];
+		}
+		ranked[rank_i] = {key, sat_list_i};
+	}
+}
+
+template <typename Config>
+static inline bool assign_user_beam(const Scenario& scenario, vector<SatBeamEntry<Config>>& sat_beam_list, 
+									CandidateRanking& ranking, const UserVisibilityEntry& user_entry, const sat_id_t* visible_sats, 
+									const vector_3d_t* visible_sat_dirs, vector<BeamAssignment>& out_assignments) {
+	/**
+	 * Greedy step for one user: assign it a beam from the first of its visible satellites, in 
+	 * ranking's order, that has one free without self interference, appending it to out_assignments. 
+	 * Returns false if none could. Full sats are skipped on their ranking.full_sats bit. 
+	 * */
+	user_id_t user_i = user_entry.user_id;
+	int num_candidates = user_entry.num_visible_sats;
+	if (ranking.order != CANDIDATE_ORDER_ID) {
+		rank_candidates(scenario, sat_beam_list, ranking, user_entry, visible_sats, visible_sat_dirs);
+		num_candidates = (int) ranking.ranked.size();
+	}
+
+	// iterate through all visible satellites for this user
+	bool assigned = false;
+	for (int rank_i = 0; rank_i < num_candidates && !assigned; rank_i ++) {
+		int sat_list_i = ranking.order == CANDIDATE_ORDER_ID ? rank_i : ranking.ranked[rank_i].second;
+		sat_id_t sat_i = visible_sats[sat_list_i];
+
+		// see if has beams left to delegate
+		if (sat_is_full(ranking.full_sats, sat_i)) {
+			// go to next sat 
+			PROFILE_COUNT(PROFILE_ASSIGN_SAT_FULL);
+			continue;
+		}
+		SatBeamEntry<Config>& beam_entry = sat_beam_list[sat_i]; // sat_beam is 0-indexed, sat_id is 1
+		assert(beam_entry.sat_id == sat_i);
+		assert(beam_entry.total_sat_beam_count < Config::beams_per_satellite);
+
+		// check if sat in user visibility 
+		vector_3d_t sat_pos = position_at(scenario.sats, sat_i); 
+		vector_3d_t user_pos = position_at(scenario.users, user_i);
+		const vector_3d_t& user_dir = visible_sat_dirs[sat_list_i];
+
+		// Constraint: sat must not already be serving a color beam 
+		int color_i = find_beam_color(beam_entry, sat_pos, user_pos, user_dir);
+
+		// adding a beam to the user for this color is ok
+		if (color_i >= 0) {
+			// update the entry for satellite
+			int num_existing_beams = beam_entry.total_sat_beam_count;
+			beam_entry.beam_targets[num_existing_beams] = user_pos;
+			beam_entry.beam_dirs[num_existing_beams] = user_dir;
+			beam_entry.color_beams[color_i] |= (beam_mask_t) 1 << num_existing_beams;
+
+			// update the total for this satellite
+			beam_entry.total_sat_beam_count += 1;
+			if (beam_entry.total_sat_beam_count == Config::beams_per_satellite) {
+				mark_sat_full(ranking.full_sats, sat_i);
+			}
+
+			out_assignments.push_back({beam_entry.sat_id, user_i, (uint8_t) beam_entry.total_sat_beam_count, (uint8_t) color_i});
+			assigned = true;
+		}
+	}
+
+	// the user is out of the running for all of its sats either way
+	if (ranking.sat_demand != nullptr) {
+		for (int sat_list_i = 0; sat_list_i < user_entry.num_visible_sats; sat_list_i ++) {
+			ranking.sat_demand[visible_sats[sat_list_i]] -= 1;
+		}
+	}
+	if (!assigned) {
+		PROFILE_COUNT(PROFILE_ASSIGN_USERS_UNASSIGNED);
+	}
+	return assigned;
+}
+
+// users assign_beams assigns between publishing its assignments to an AssignmentFeed
+#define FEED_PUBLISH_USERS 4096
+
+struct AssignmentFeed {
+	/**
+	 * The first num_published of arena.assignments, which are final, for a thread writing them 
+	 * out while assignment is still running (see solve_scenario_pipelined). Guarded by lock. 
+	 */
+	mutex lock;
+	condition_variable published_cv;
+	const BeamAssignment* assignments;
+	size_t num_published;
+	bool done;
+};
+
+static inline void publish_assignments(AssignmentFeed& feed, const vector<BeamAssignment>& assignments, bool done) {
+	lock_guard<mutex> guard(feed.lock);
+	feed.assignments = assignments.data();
+	feed.num_published = assignments.size();
+	feed.done = done;
+	feed.published_cv.notify_one();
+}
+
+template <typename Config>
+static inline void assign_beams(const Scenario& scenario, SolveArena<Config>& arena, CandidateOrder order = CANDIDATE_ORDER_ID, 
+								AssignmentFeed* feed = nullptr) {
+	/**
+	 * Append the beam assignments to arena.assignments given inputs. Considers each user by traversing
+	 * user_vis_list in ascending order and assigns a beam from an availible satellite, trying them in 
+	 * order (see CandidateOrder). 
+	 * 
+	 * scenario: user, sat, and interferer locations
+	 * arena.user_vis_list: list of users and their visible satellites (see visible_sats_of)
+	 * arena.sat_beam_list: list of satellites and their currently allocated beams, 
+	 * 		s.t. length of sat_beam_list = # sats 
+	 * 		s.t. sat_beam_list[i] has data for sat with id i+1
+	 * feed: if set, every FEED_PUBLISH_USERS users the assignments so far are published to it, 
+	 * 		and all of them once done. arena.assignments doesn't reallocate in between. 
+	 * */
+
+	const vector<UserVisibilityEntry>& user_vis_list = arena.user_vis_list;
+	arena.assignments.reserve(arena.assignments.size() + user_vis_list.size());
+	CandidateRanking ranking = prepare_candidate_ranking(arena, order);
+	VisibleSatsScratch scratch;
+
+	// iterate through users	
+	int users_since_publish = 0;
+	for (const UserVisibilityEntry& user_entry : user_vis_list) {
+		VisibleSats visible = visible_sats_of(scenario, arena, user_entry, scratch);
+		assign_user_beam(scenario, arena.sat_beam_list, ranking, user_entry, visible.ids, visible.dirs, arena.assignments);
+		if (feed != nullptr && ++ users_since_publish == FEED_PUBLISH_USERS) {
+			publish_assignments(*feed, arena.assignments, false);
+			users_since_publish = 0;
+		}
+	} 
+	if (feed != nullptr) {
+		publish_assignments(*feed, arena.assignments, true);
+	}
+}
+
+static inline CandidateOrder candidate_order_of(const SolveOptions& options) {
+	/**
+	 * options.candidate_order, which the command line has already checked 
+	 * */
+	CandidateOrder order = CANDIDATE_ORDER_ID;
+	find_candidate_order(options.candidate_order, &order);
+	return order;
+}
+
+// most longitude bands assign_beams_parallel_ordered splits sats into, one per thread 
+#define ASSIGN_REGIONS 16
+
+template <typename Config>
+static inline void assign_beams_parallel_ordered(const Scenario& scenario, const SolveOptions& options, SolveArena<Config>& arena) {
+	/**
+	 * Same greedy as assign_beams, in parallel over longitude bands but committing users in 
+	 * user_vis_list order, so the solution is byte-identical to assign_beams' for any thread count. 
+	 * 
+	 * Sats are split into one band per thread (at most ASSIGN_REGIONS, or the core count), and each 
+	 * band's worker runs the users whose visible sats touch its band, in user_vis_list order. A user 
+	 * only reads and writes the beams of its own visible sats, so users of different bands can go in any order. 
+	 * A user straddling bands is run by the lowest of them once every band it touches has reached 
+	 * it, the others waiting until it's done, so every sat sees its users in the serial order. Bands 
+	 * only wait on each other at straddling users, and every band needs its own thread, spinning 
+	 * while it waits, so there are never more bands than cores: on 1 core with --threads 4 the 
+	 * spinning bands took 15.1ms on 11_one_hundred_thousand_users against 4.8ms for assign_beams. 
+	 * */
+	int num_cores = MAX(1, (int) thread::hardware_concurrency());
+	int num_bands = MIN(MIN(options.num_threads, num_cores), ASSIGN_REGIONS);
+	if (num_bands <= 1) {
+		assign_beams(scenario, arena, candidate_order_of(options));
+		return;
+	}
+
+	const vector<UserVisibilityEntry>& user_vis_list = arena.user_vis_list;
+	int num_users = (int) user_vis_list.size();
+	arena.assignments.reserve(arena.assignments.size() + num_users);
+
+	int num_sats = num_positions(scenario.sats);
+	vector<int> sat_band(num_sats);
+	for (int sat_i = 0; sat_i < num_sats; sat_i ++) {
+		float lon_frac = (atan2(scenario.sats.ys[sat_i], scenario.sats.xs[sat_i]) + M_PI) / (2.0 * M_PI);
+		sat_band[sat_i] = (int) (lon_frac * num_bands) % num_bands;
+	}
+
+	// bit b of user_bands[i] is set if user_vis_list[i] sees a sat in band b, and band_users[b] 
+	// lists those users in order
+	CandidateRanking ranking = prepare_candidate_ranking(arena, candidate_order_of(options));
+	VisibleSatsScratch scratch;
+	vector<uint32_t> user_bands(num_users, 0);
+	vector<vector<int>> band_users(num_bands);
+	for (int i = 0; i < num_users; i ++) {
+		const sat_id_t* visible_sats = visible_sat_ids_of(arena, user_vis_list[i], scratch);
+		for (int sat_list_i = 0; sat_list_i < user_vis_list[i].num_visible_sats; sat_list_i ++) {
+			user_bands[i] |= (uint32_t) 1 << sat_band[visible_sats[sat_list_i]];
+		}
+		for (int band = 0; band < num_bands; band ++) {
+			if ((user_bands[i] >> band) & 1) {
+				band_users[band].push_back(i);
+			}
+		}
+	}
+
+	// for straddling users, how many of its other bands have reached it and whether it's done
+	vector<int> arrived(num_users, 0);
+	vector<int> done(num_users, 0);
+	// each user's assignment, if assigned[i], written by whichever band runs it
+	vector<BeamAssignment> user_assignments(num_users);
+	vector<char> assigned(num_users, 0);
+
+	parallel_for_chunks(num_bands, num_bands, [&](int band) {
+		CandidateRanking band_ranking = ranking;
+		VisibleSatsScratch band_scratch;
+		vector<BeamAssignment> out = {};
+		for (int i : band_users[band]) {
+			uint32_t bands = user_bands[i];
+			bool straddling = bands != (uint32_t) 1 << band;
+			if (straddling && (bands & -bands) != (uint32_t) 1 << band) {
+				// not the lowest band, so hand over this band's beams and wait for the user to be run
+				__atomic_fetch_add(&arrived[i], 1, __ATOMIC_RELEASE);
+				while (!__atomic_load_n(&done[i], __ATOMIC_ACQUIRE)) {
+					this_thread::yield();
+				}
+				continue;
+			}
+			if (straddling) {
+				int num_others = __builtin_popcount(bands) - 1;
+				while (__atomic_load_n(&arrived[i], __ATOMIC_ACQUIRE) < num_others) {
+					this_thread::yield();
+				}
+			}
+
+			VisibleSats visible = visible_sats_of(scenario, arena, user_vis_list[i], band_scratch);
+			out.clear();
+			if (assign_user_beam(scenario, arena.sat_beam_list, band_ranking, user_vis_list[i], visible.ids, visible.dirs, out)) {
+				user_assignments[i] = out.back();
+				assigned[i] = 1;
+			}
+			if (straddling) {
+				__atomic_store_n(&done[i], 1, __ATOMIC_RELEASE);
+			}
+		}
+	});
+
+	for (int i = 0; i < num_users; i ++) {
+		if (assigned[i]) {
+			arena.assignments.push_back(user_assignments[i]);
+		}
+	}
+}
+
+struct BeamOwners {
+	/**
+	 * Who holds which beam, so beams can be moved after the greedy has placed them. Once a beam is 
+	 * removed a sat's beams are the set bits of its color_beams, not its first total_sat_beam_count slots. 
+	 */ 
+	// user of each beam, users[sat_id * beams_per_satellite + slot], -1 if free
+	vector<user_id_t> users;
+
+	// each user's beam as (sat_id, slot, color_i), sat_id = -1 if unassigned
+	vector<tuple<sat_id_t, int, int>> user_beams;
+
+	// index of each user's entry in user_vis_list
+	vector<int> user_entries;
+};
+
+template <typename Config>
+static inline void place_beam(SatBeamEntry<Config>& beam_entry, BeamOwners& owners, user_id_t user_i, int slot, int color_i, 
+							  vector_3d_t user_pos, const vector_3d_t& user_dir) {
+	beam_entry.beam_targets[slot] = user_pos;
+	beam_entry.beam_dirs[slot] = user_dir;
+	beam_entry.color_beams[color_i] |= (beam_mask_t) 1 << slot;
+	beam_entry.total_sat_beam_count += 1;
+	owners.users[beam_entry.sat_id * Config::beams_per_satellite + slot] = user_i;
+	owners.user_beams[user_i] = make_tuple(beam_entry.sat_id, slot, color_i);
+}
+
+template <typename Config>
+static inline void remove_beam(SatBeamEntry<Config>& beam_entry, BeamOwners& owners, user_id_t user_i) {
+	int slot = get<1>(owners.user_beams[user_i]);
+	int color_i = get<2>(owners.user_beams[user_i]);
+	beam_entry.color_beams[color_i] &= ~((beam_mask_t) 1 << slot);
+	beam_entry.total_sat_beam_count -= 1;
+	owners.users[beam_entry.sat_id * Config::beams_per_satellite + slot] = -1;
+	owners.user_beams[user_i] = make_tuple(-1, 0, 0);
+}
+
+template <typename Config>
+static inline bool try_place_beam(const Scenario& scenario, SatBeamEntry<Config>& beam_entry, BeamOwners& owners, 
+								  user_id_t user_i, const vector_3d_t& user_dir) {
+	/**
+	 * Give user_i a beam on beam_entry's sat, in its lowest free slot, if it has one and a color 
+	 * that doesn't self interfere 
+	 * */
+	if (beam_entry.total_sat_beam_count >= Config::beams_per_satellite) {
+		return false;
+	}
+	vector_3d_t sat_pos = position_at(scenario.sats, beam_entry.sat_id);
+	vector_3d_t user_pos = position_at(scenario.users, user_i);
+	int color_i = find_beam_color(beam_entry, sat_pos, user_pos, user_dir);
+	if (color_i < 0) {
+		return false;
+	}
+	beam_mask_t used_beams = 0;
+	for (beam_mask_t color_beams : beam_entry.color_beams) {
+		used_beams |= color_beams;
+	}
+	place_beam(beam_entry, owners, user_i, __builtin_ctzll(~used_beams), color_i, user_pos, user_dir);
+	return true;
+}
+
+template <typename Config>
+static inline bool relocate_beam(const Scenario& scenario, SolveArena<Config>& arena, BeamOwners& owners, user_id_t user_i, 
+								 sat_id_t except_sat, VisibleSatsScratch& scratch) {
+	/**
+	 * Give user_i (currently unassigned) a beam on any of its visible sats but except_sat
+	 * */
+	const UserVisibilityEntry& entry = arena.user_vis_list[owners.user_entries[user_i]];
+	VisibleSats visible = visible_sats_of(scenario, arena, entry, scratch);
+	for (int sat_list_i = 0; sat_list_i < visible.count; sat_list_i ++) {
+		sat_id_t sat_i = visible.ids[sat_list_i];
+		if (sat_i != except_sat && try_place_beam(scenario, arena.sat_beam_list[sat_i], owners, user_i, visible.dirs[sat_list_i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename Config>
+static inline bool repair_user(const Scenario& scenario, SolveArena<Config>& arena, BeamOwners& owners, const UserVisibilityEntry& entry, 
+							   VisibleSatsScratch& user_scratch, VisibleSatsScratch& relocate_scratch) {
+	/**
+	 * Local search step for an unassigned user: on each of its visible sats, try moving one of the 
+	 * sat's beams to another sat its user sees, so the freed slot (or color) fits this user. 
+	 * Every move is undone unless the user ends up with a beam, so coverage only goes up. 
+	 * */
+	user_id_t user_i = entry.user_id;
+	VisibleSats visible = visible_sats_of(scenario, arena, entry, user_scratch);
+	for (int sat_list_i = 0; sat_list_i < visible.count; sat_list_i ++) {
+		sat_id_t sat_i = visible.ids[sat_list_i];
+		const vector_3d_t& user_dir = visible.dirs[sat_list_i];
+		SatBeamEntry<Config>& beam_entry = arena.sat_beam_list[sat_i];
+		if (try_place_beam(scenario, beam_entry, owners, user_i, user_dir)) {
+			return true;
+		}
+
+		for (int slot = 0; slot < Config::beams_per_satellite; slot ++) {
+			user_id_t other_i = owners.users[sat_i * Config::beams_per_satellite + slot];
+			if (other_i < 0 || arena.user_vis_list[owners.user_entries[other_i]].num_visible_sats < 2) {
+				continue;
+			}
+			int other_color_i = get<2>(owners.user_beams[other_i]);
+			vector_3d_t other_pos = beam_entry.beam_targets[slot];
+			vector_3d_t other_dir = beam_entry.beam_dirs[slot];
+
+			remove_beam(beam_entry, owners, other_i);
+			if (try_place_beam(scenario, beam_entry, owners, user_i, user_dir)) {
+				if (relocate_beam(scenario, arena, owners, other_i, sat_i, relocate_scratch)) {
+					return true;
+				}
+				remove_beam(beam_entry, owners, user_i);
+			}
+			// nothing else changed, so the old beam still fits where it was
+			place_beam(beam_entry, owners, other_i, slot, other_color_i, other_pos, other_dir);
+		}
+	}
+	return false;
+}
+
+template <typename Config>
+static inline void assign_beams_repair(const Scenario& scenario, const SolveOptions& options, SolveArena<Config>& arena) {
+	/**
+	 * The serial greedy, then repair_user for every user it left unassigned, least coverage first, 
+	 * until options.assign_budget_ms (timed from the end of the greedy) runs out. arena.assignments is 
+	 * rebuilt from the final beams. 
+	 * */
+	assign_beams(scenario, arena, candidate_order_of(options));
+
+	// the budget only covers repair, the greedy is already done
+	using assign_clock = chrono::steady_clock;
+	assign_clock::time_point start = assign_clock::now();
+
+	int num_users = num_positions(scenario.users);
+	BeamOwners owners;
+	owners.users.assign(arena.sat_beam_list.size() * Config::beams_per_satellite, -1);
+	owners.user_beams.assign(num_users, make_tuple(-1, 0, 0));
+	owners.user_entries.assign(num_users, -1);
+	for (int i = 0; i < (int) arena.user_vis_list.size(); i ++) {
+		owners.user_entries[arena.user_vis_list[i].user_id] = i;
+	}
+	for (const BeamAssignment& assignment : arena.assignments) {
+		owners.users[assignment.sat_id * Config::beams_per_satellite + assignment.beam_id - 1] = assignment.user_id;
+		owners.user_beams[assignment.user_id] = make_tuple(assignment.sat_id, assignment.beam_id - 1, assignment.color_i);
+	}
+
+	int num_repaired = 0;
+	VisibleSatsScratch user_scratch;
+	VisibleSatsScratch relocate_scratch;
+	for (int i = 0; i < (int) arena.user_vis_list.size(); i ++) {
+		const UserVisibilityEntry& entry = arena.user_vis_list[i];
+		if (entry.num_visible_sats == 0 || get<0>(owners.user_beams[entry.user_id]) >= 0) {
+			continue;
+		}
+		if (options.assign_budget_ms > 0 && 
+			chrono::duration<double, milli>(assign_clock::now() - start).count() > options.assign_budget_ms) {
+			break;
+		}
+		num_repaired += repair_user(scenario, arena, owners, entry, user_scratch, relocate_scratch);
+	}
+	if (num_repaired == 0) {
+		return;
+	}
+
+	arena.assignments.clear();
+	for (const UserVisibilityEntry& entry : arena.user_vis_list) {
+		const tuple<sat_id_t, int, int>& beam = owners.user_beams[entry.user_id];
+		if (get<0>(beam) >= 0) {
+			arena.assignments.push_back({get<0>(beam), entry.user_id, (uint8_t) (get<1>(beam) + 1), (uint8_t) get<2>(beam)});
+		}
+	}
+}
+
+template <typename Config>
+static inline void assign_beams_greedy(const Scenario& scenario, const SolveOptions& options, SolveArena<Config>& arena) {
+	assign_beams(scenario, arena, candidate_order_of(options));
+}
+
+// fills arena.assignments from the sorted arena.user_vis_list
+template <typename Config>
+using assign_strategy_fn_t = void (*)(const Scenario& scenario, const SolveOptions& options, SolveArena<Config>& arena);
+
+template <typename Config>
+struct AssignStrategy {
+	const char* name;
+	assign_strategy_fn_t<Config> assign;
+};
+
+// chosen by SolveOptions::assign_strategy, the same strategies for every config
+template <typename Config>
+static const AssignStrategy<Config> ASSIGN_STRATEGIES[] = {
+	// first visible sat with a free beam, first color that fits
+	{"greedy", assign_beams_greedy<Config>},
+	// greedy over longitude bands in parallel, committed in order so it matches "greedy" exactly, 
+	// see assign_beams_parallel_ordered
+	{"parallel-ordered", assign_beams_parallel_ordered<Config>},
+	// greedy, then local search for the users it left out, see assign_beams_repair
+	{"repair", assign_beams_repair<Config>},
+};
+
+template <typename Config>
+static inline const AssignStrategy<Config>* find_assign_strategy(const string& name) {
+	/**
+	 * The strategy called name, nullptr if there's none
+	 * */
+	for (const AssignStrategy<Config>& strategy : ASSIGN_STRATEGIES<Config>) {
+		if (name == strategy.name) {
+			return &strategy;
+		}
+	}
+	return nullptr;
+}
+
+static inline string assign_strategy_names() {
+	string names = "";
+	for (const AssignStrategy<StarlinkConfig>& strategy : ASSIGN_STRATEGIES<StarlinkConfig>) {
+		names += names == "" ? strategy.name : string("|") + strategy.name;
+	}
+	return names;
+}
+
+// float cone tests within this of cos_non_starlink_interference_max are redone with the exact 
+// (double) check, and zenith ranges are widened by INTERFERER_ZENITH_COS_MARGIN
+#define INTERFERER_CONE_COS_MARGIN 1e-4
+#define INTERFERER_ZENITH_COS_MARGIN 1e-3
+
+struct InterfererCones {
+	/**
+	 * Unit directions from one user to each interferer that could interfere with a sat the user 
+	 * sees, sorted ascending by the cos of their angle from the user's zenith 
+	 */
+	vector<float> cos_zeniths;
+	vector<float> xs;
+	vector<float> ys;
+	vector<float> zs;
+	vector<int> interferer_ids;
+};
+
+template <typename Config>
+static inline void build_interferer_cones(const Scenario& scenario, user_id_t user_i, InterfererCones& cones) {
+	/**
+	 * Fill cones for user_i. Interferers at the user's position have no direction, and the exact 
+	 * check never flags them, so they're left out too 
+	 * */
+	vector_3d_t user_pos = position_at(scenario.users, user_i);
+	float up[3] = {scenario.users.unit_xs[user_i], scenario.users.unit_ys[user_i], scenario.users.unit_zs[user_i]};
+
+	cones.cos_zeniths.clear();
+	cones.xs.clear();
+	cones.ys.clear();
+	cones.zs.clear();
+	cones.interferer_ids.clear();
+
+	// relevant if dot(d, up) / |d| >= cos_interferer_relevant_zenith, tested without the sqrt
+	float cos_sq_relevant = Config::cos_interferer_relevant_zenith * Config::cos_interferer_relevant_zenith;
+	int num_interferers = num_positions(scenario.interferers);
+	for (int int_i = 0; int_i < num_interferers; int_i ++) {
+		float d[3] = {scenario.interferers.xs[int_i] - user_pos[0], scenario.interferers.ys[int_i] - user_pos[1], 
+					  scenario.interferers.zs[int_i] - user_pos[2]};
+		float d_up = d[0] * up[0] + d[1] * up[1] + d[2] * up[2];
+		float mag_sq = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+		if (mag_sq == 0 || d_up < 0 || d_up * d_up < cos_sq_relevant * mag_sq) {
+			continue;
+		}
+
+		// insertion sort by cos_zenith, there are only ever a handful
+		float inv_mag = 1.0f / sqrt(mag_sq);
+		float cos_zenith = d_up * inv_mag;
+		int cone_i = (int) cones.cos_zeniths.size();
+		cones.cos_zeniths.push_back(cos_zenith);
+		cones.xs.push_back(0);
+		cones.ys.push_back(0);
+		cones.zs.push_back(0);
+		cones.interferer_ids.push_back(0);
+		for (; cone_i > 0 && cones.cos_zeniths[cone_i - 1] > cos_zenith; cone_i --) {
+			cones.cos_zeniths[cone_i] = cones.cos_zeniths[cone_i - 1];
+			cones.xs[cone_i] = cones.xs[cone_i - 1];
+			cones.ys[cone_i] = cones.ys[cone_i - 1];
+			cones.zs[cone_i] = cones.zs[cone_i - 1];
+			cones.interferer_ids[cone_i] = cones.interferer_ids[cone_i - 1];
+		}
+		cones.cos_zeniths[cone_i] = cos_zenith;
+		cones.xs[cone_i] = d[0] * inv_mag;
+		cones.ys[cone_i] = d[1] * inv_mag;
+		cones.zs[cone_i] = d[2] * inv_mag;
+		cones.interferer_ids[cone_i] = int_i;
+	}
+}
+
+template <typename Config, typename cone_fn_t>
+static inline bool find_interferer_cone(const Scenario& scenario, const InterfererCones& cones, user_id_t user_i, 
+										vector_3d_t user_pos, vector_3d_t sat_pos, cone_fn_t cone_fn) {
+	/**
+	 * Calls cone_fn(cone_i, cos_angle) for each of cones that could be within non_starlink_interference_max 
+	 * of sat_pos as seen from user_i, cos_angle the float cos of the angle between them, until it returns 
+	 * true. Returns whether it did. 
+	 * 
+	 * By the triangle inequality, only interferers whose zenith angle is within 
+	 * non_starlink_interference_max of the sat's can be that close, and those are a contiguous 
+	 * range of cones. Each is then a dot product against the sat's direction. 
+	 * */
+	float w[3] = {sat_pos[0] - user_pos[0], sat_pos[1] - user_pos[1], sat_pos[2] - user_pos[2]};
+	float w_mag = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+	if (w_mag == 0) {
+		return false;
+	}
+	float inv_w_mag = 1.0f / w_mag;
+	w[0] *= inv_w_mag;
+	w[1] *= inv_w_mag;
+	w[2] *= inv_w_mag;
+
+	// cos of the sat's zenith angle z, and the cos range of zenith angles in [z - max, z + max]
+	double cos_z = w[0] * scenario.users.unit_xs[user_i] + w[1] * scenario.users.unit_ys[user_i] + w[2] * scenario.users.unit_zs[user_i];
+	double sin_z = sqrt(MAX(0.0, 1.0 - cos_z * cos_z));
+	double lo = cos_z * Config::cos_non_starlink_interference_max - sin_z * Config::sin_non_starlink_interference_max - INTERFERER_ZENITH_COS_MARGIN;
+	double hi = cos_z * Config::cos_non_starlink_interference_max + sin_z * Config::sin_non_starlink_interference_max + INTERFERER_ZENITH_COS_MARGIN;
+	if (cos_z >= Config::cos_non_starlink_interference_max - INTERFERER_ZENITH_COS_MARGIN) {
+		// z - max wraps past the zenith
+		hi = 2.0;
+	}
+
+	int begin = (int) (lower_bound(cones.cos_zeniths.begin(), cones.cos_zeniths.end(), (float) lo) - cones.cos_zeniths.begin());
+	int end = (int) (upper_bound(cones.cos_zeniths.begin(), cones.cos_zeniths.end(), (float) hi) - cones.cos_zeniths.begin());
+	PROFILE_ADD(PROFILE_INTERFERER_CONE_TESTS, end - begin);
+	for (int cone_i = begin; cone_i < end; cone_i ++) {
+		float cos_angle = w[0] * cones.xs[cone_i] + w[1] * cones.ys[cone_i] + w[2] * cones.zs[cone_i];
+		if (cone_fn(cone_i, cos_angle)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename Config>
+static inline bool interferer_violation(const Scenario& scenario, const InterfererCones& cones, user_id_t user_i, 
+										vector_3d_t user_pos, vector_3d_t sat_pos) {
+	/**
+	 * True if some interferer is within non_starlink_interference_max of sat_pos as seen from user_i, 
+	 * same as running angle_less_than against every interferer, see find_interferer_cone 
+	 * */
+	return find_interferer_cone<Config>(scenario, cones, user_i, user_pos, sat_pos, [&](int cone_i, float cos_angle) {
+		if (cos_angle > Config::cos_non_starlink_interference_max + INTERFERER_CONE_COS_MARGIN) {
+			return true;
+		}
+		if (cos_angle <= Config::cos_non_starlink_interference_max - INTERFERER_CONE_COS_MARGIN) {
+			return false;
+		}
+		PROFILE_COUNT(PROFILE_INTERFERER_EXACT_CHECKS);
+		vector_3d_t int_pos = position_at(scenario.interferers, cones.interferer_ids[cone_i]);
+		return angle_violates<Config>(user_pos, int_pos, sat_pos, Config::cos_non_starlink_interference_max, false);
+	});
+}
+
+struct VisScratch {
+	/**
+	 * Per-thread scratch space for append_visible_sats, reused across users
+	 */
+	vis_mask_kernel_t mask_kernel;
+	vector<SatGridRun> runs;
+	vector<uint32_t> mask;
+	vector<int> candidate_slots;
+	InterfererCones cones;
+};
+
+static inline void gather_candidate_slots(const SatGrid& sat_grid, vector_3d_t user_pos, float cone_deg, VisScratch& scratch) {
+	/**
+	 * Fills scratch.candidate_slots, in ascending order, with the sats that may be within cone_deg 
+	 * of the user's zenith: the ones sat_grid returns for the user that the visibility mask kernel 
+	 * flags, and any unbucketed ones. 
+	 * 
+	 * A sat within cone_deg of the user's zenith (an angle > 180 - cone_deg at the user in the 
+	 * origin-user-sat triangle) always has its direction from ORIGIN within cone_deg of the user's. 
+	 * */
+	vector<int>& candidate_slots = scratch.candidate_slots;
+	candidate_slots.assign(sat_grid.unbucketed_slots.begin(), sat_grid.unbucketed_slots.end());
+
+	query_sat_grid(sat_grid, user_pos, cone_deg + SAT_GRID_QUERY_MARGIN_DEG, scratch.runs);
+	VisQuery query = vis_query_of(user_pos, cone_deg);
+	for (const SatGridRun& run : scratch.runs) {
+		int count = run.end - run.begin;
+		if (count == 0) {
+			continue;
+		}
+		scratch.mask.resize((count + 31) / 32);
+		scratch.mask_kernel(&sat_grid.xs[run.begin], &sat_grid.ys[run.begin], &sat_grid.zs[run.begin], 
+							count, query, scratch.mask.data());
+		for (int word_i = 0; word_i < (int) scratch.mask.size(); word_i ++) {
+			for (uint32_t bits = scratch.mask[word_i]; bits != 0; bits &= bits - 1) {
+				candidate_slots.push_back(sat_grid.cell_slots[run.begin + word_i * 32 + __builtin_ctz(bits)]);
+			}
+		}
+	}
+
+	sort(candidate_slots.begin(), candidate_slots.end());
+}
+
+template <typename Config>
+static inline int append_candidate_sats(const Scenario& scenario, const vector<SatBeamEntry<Config>>& sat_beam_list, 
+										user_id_t user_i, VisScratch& scratch, vector<sat_id_t>& out_sat_ids, 
+										vector<vector_3d_t>& out_sat_dirs) {
+	/**
+	 * Appends to out_sat_ids, in sat_beam_list order, every sat of scratch.candidate_slots (ascending, 
+	 * and a superset of the sats in range) user_i could connect to while observing 
+	 * 	1) user visibility constraint and 2) non-starlink interferer constraint. Returns # sats appended. 
+	 * The direction of each from the sat to the user (beam_dir_of) goes in out_sat_dirs. 
+	 * */
+	int num_visible_sats = 0;
+
+	vector_3d_t user_pos = position_at(scenario.users, user_i);
+	const vector<int>& candidate_slots = scratch.candidate_slots;
+	bool cones_built = false;
+	PROFILE_ADD(PROFILE_VIS_CANDIDATES, candidate_slots.size());
+
+	// iterate over each candidate satellite, in sat_beam_list order
+	for (int slot : candidate_slots) {
+		const SatBeamEntry<Config>& beam_entry = sat_beam_list[slot];
+
+		// check if sat in user visibility 
+		sat_id_t sat_id = beam_entry.sat_id;
+
+		vector_3d_t sat_pos = position_at(scenario.sats, sat_id); 
+
+		// Constraint: sat must be visible to user. A user at ORIGIN has no zenith, and fails this for 
+		// every sat. The baseline's float angle was NaN there, and it passed every sat instead, but 
+		// evaluate.py divides by the zero magnitude and can't check a beam to such a user at all
+		if (angle_violates<Config>(user_pos, ORIGIN, sat_pos, Config::cos_user_visible_bound, true)) {
+			// sat is outside of range of user 
+			// go to next sat 
+			PROFILE_COUNT(PROFILE_VIS_REJECTED_VISIBILITY);
+			continue;
+		}
+
+		// Constraint: angle with user must not be too small w/ interferer
+		if (!cones_built) {
+			build_interferer_cones<Config>(scenario, user_i, scratch.cones);
+			cones_built = true;
+		}
+		if (interferer_violation<Config>(scenario, scratch.cones, user_i, user_pos, sat_pos)) {
+			// interferer
+			// go to next sat
+			PROFILE_COUNT(PROFILE_VIS_REJECTED_INTERFERER);
+			continue;
+		}
+
+		// if here, sat could form beam w user 
+		out_sat_ids.push_back(sat_id);
+		out_sat_dirs.push_back(beam_dir_of(sat_pos, user_pos));
+		num_visible_sats += 1;
+	}
+	PROFILE_ADD(PROFILE_VIS_ACCEPTED, num_visible_sats);
+	return num_visible_sats;
+}
+
+template <typename Config>
+static inline int append_visible_sats(const Scenario& scenario, const SatGrid& sat_grid, const vector<SatBeamEntry<Config>>& sat_beam_list, 
+							   user_id_t user_i, VisScratch& scratch, vector<sat_id_t>& out_sat_ids, 
+							   vector<vector_3d_t>& out_sat_dirs) {
+	/**
+	 * append_candidate_sats of the candidates gather_candidate_slots finds for user_i 
+	 * */
+	gather_candidate_slots(sat_grid, position_at(scenario.users, user_i), Config::max_user_visible_angle, scratch);
+	return append_candidate_sats(scenario, sat_beam_list, user_i, scratch, out_sat_ids, out_sat_dirs);
+}
+
+template <typename Config, typename gather_fn_t>
+static inline void append_chunk_visible_sats(const Scenario& scenario, const vector<SatBeamEntry<Config>>& sat_beam_list, 
+											 int chunk_i, VisScratch& scratch, gather_fn_t& gather_fn, 
+											 vector<UserVisibilityEntry>& user_vis_list, vector<sat_id_t>& out_sat_ids, 
+											 vector<vector_3d_t>& out_sat_dirs) {
+	/**
+	 * Visible sats of users [chunk_i * VIS_CHUNK_USERS, ...) of the candidates gather_fn(user_i, scratch) 
+	 * finds, into their (presized) user_vis_list entries and the chunk's out_sat_ids / out_sat_dirs. 
+	 * Entry offsets are chunk relative until stitch_chunk_visible_sats. 
+	 * */
+	int num_users = num_positions(scenario.users);
+	int chunk_end = MIN(num_users, (chunk_i + 1) * VIS_CHUNK_USERS);
+	for (int user_i = chunk_i * VIS_CHUNK_USERS; user_i < chunk_end; user_i ++) {
+		int first_visible_sat = (int) out_sat_ids.size();
+		gather_fn(user_i, scratch);
+		int num_visible_sats = append_candidate_sats(scenario, sat_beam_list, user_i, scratch, out_sat_ids, out_sat_dirs);
+		user_vis_list[user_i] = {user_i, first_visible_sat, num_visible_sats};
+	}
+}
+
+template <typename Config>
+static inline void stitch_chunk_visible_sats(int num_users, const vector<vector<sat_id_t>>& chunk_sat_ids, 
+											 const vector<vector<vector_3d_t>>& chunk_sat_dirs, SolveArena<Config>& arena) {
+	/**
+	 * Concatenate the chunks of append_chunk_visible_sats into arena.visible_sat_ids / visible_sat_dirs 
+	 * in user order, making the entries' offsets absolute 
+	 * */
+	vector<UserVisibilityEntry>& user_vis_list = arena.user_vis_list;
+	vector<sat_id_t>& visible_sat_ids = arena.visible_sat_ids;
+	vector<vector_3d_t>& visible_sat_dirs = arena.visible_sat_dirs;
+	int num_chunks = (int) chunk_sat_ids.size();
+	size_t num_visible_total = 0;
+	for (const vector<sat_id_t>& sat_ids : chunk_sat_ids) {
+		num_visible_total += sat_ids.size();
+	}
+	visible_sat_ids.reserve(num_visible_total);
+	visible_sat_dirs.reserve(num_visible_total);
+	for (int chunk_i = 0; chunk_i < num_chunks; chunk_i ++) {
+		int chunk_base = (int) visible_sat_ids.size();
+		int chunk_end = MIN(num_users, (chunk_i + 1) * VIS_CHUNK_USERS);
+		for (int user_i = chunk_i * VIS_CHUNK_USERS; user_i < chunk_end; user_i ++) {
+			user_vis_list[user_i].first_visible_sat += chunk_base;
+		}
+		visible_sat_ids.insert(visible_sat_ids.end(), chunk_sat_ids[chunk_i].begin(), chunk_sat_ids[chunk_i].end());
+		visible_sat_dirs.insert(visible_sat_dirs.end(), chunk_sat_dirs[chunk_i].begin(), chunk_sat_dirs[chunk_i].end());
+	}
+}
+
+template <typename Config, typename gather_fn_t>
+static inline void generate_user_vis_list_by_user(const Scenario& scenario, const SolveOptions& options, 
+												  SolveArena<Config>& arena, gather_fn_t gather_fn) {
+	/**
+	 * Generates arena.user_vis_list given the scenario, one user at a time
+	 * 
+	 * Fills a list of len(# users), where each entry contains a user_id and sats that user 
+	 * 	could connect to (see append_candidate_sats), of the candidates gather_fn(user_i, scratch) 
+	 * 	puts in scratch.candidate_slots. The sats themselves go in arena.visible_sat_ids, and their 
+	 * 	directions to the user in arena.visible_sat_dirs. 
+	 * 
+	 * Users are independent, so they're split into chunks of VIS_CHUNK_USERS spread over 
+	 * options.num_threads threads. Each chunk writes its own entries in place and its sats to its 
+	 * own buffer, and buffers are stitched together in user order, so the result doesn't depend 
+	 * on the thread count. 
+	 * */
+
+	int num_users = num_positions(scenario.users);
+	int num_chunks = (num_users + VIS_CHUNK_USERS - 1) / VIS_CHUNK_USERS;
+	arena.user_vis_list.resize(num_users);
+	vector<vector<sat_id_t>> chunk_sat_ids(num_chunks);
+	vector<vector<vector_3d_t>> chunk_sat_dirs(num_chunks);
+
+	parallel_for_chunks(num_chunks, options.num_threads, [&](int chunk_i) {
+		VisScratch scratch = {};
+		scratch.mask_kernel = select_vis_mask_kernel(options.use_simd);
+		append_chunk_visible_sats(scenario, arena.sat_beam_list, chunk_i, scratch, gather_fn, arena.user_vis_list, 
+								  chunk_sat_ids[chunk_i], chunk_sat_dirs[chunk_i]);
+	});
+	stitch_chunk_visible_sats(num_users, chunk_sat_ids, chunk_sat_dirs, arena);
+}
+
+template <typename Config>
+static inline void generate_user_vis_list_user_major(const Scenario& scenario, const SatGrid& sat_grid, 
+													 const SolveOptions& options, SolveArena<Config>& arena) {
+	/**
+	 * generate_user_vis_list_by_user of the candidates gather_candidate_slots finds in sat_grid 
+	 * */
+	generate_user_vis_list_by_user(scenario, options, arena, [&](user_id_t user_i, VisScratch& scratch) {
+		gather_candidate_slots(sat_grid, position_at(scenario.users, user_i), Config::max_user_visible_angle, scratch);
+	});
+}
+
+template <typename Config>
+static inline bool generate_user_vis_list_gpu(const Scenario& scenario, const SolveOptions& options, 
+											  SolveArena<Config>& arena, string& out_error) {
+	/**
+	 * generate_user_vis_list_by_user of the candidates gpu_vis_candidates finds, or 
+	 * gpu_vis_candidates_host if options.vis_backend is "gpu-host". They're a subset of 
+	 * gather_candidate_slots' that only lacks sats the exact checks reject, so the result is the 
+	 * same as generate_user_vis_list_user_major's. Returns false if the device couldn't be used. 
+	 * */
+	const vector<SatBeamEntry<Config>>& sat_beam_list = arena.sat_beam_list;
+	int num_slots = (int) sat_beam_list.size();
+	vector<float> sat_xs(num_slots), sat_ys(num_slots), sat_zs(num_slots);
+	for (int slot = 0; slot < num_slots; slot ++) {
+		sat_id_t sat_id = sat_beam_list[slot].sat_id;
+		sat_xs[slot] = scenario.sats.xs[sat_id];
+		sat_ys[slot] = scenario.sats.ys[sat_id];
+		sat_zs[slot] = scenario.sats.zs[sat_id];
+	}
+
+	float cos_relaxed = cos(DEG_TO_RAD(Config::max_user_visible_angle)) - VIS_KERNEL_COS_MARGIN;
+	GpuVisProblem problem = {
+		num_positions(scenario.users), scenario.users.xs.data(), scenario.users.ys.data(), scenario.users.zs.data(), 
+		num_slots, sat_xs.data(), sat_ys.data(), sat_zs.data(), 
+		num_positions(scenario.interferers), scenario.interferers.xs.data(), scenario.interferers.ys.data(), scenario.interferers.zs.data(), 
+		cos_relaxed * cos_relaxed, (float) (Config::cos_non_starlink_interference_max + INTERFERER_CONE_COS_MARGIN)
+	};
+	GpuVisCandidates candidates;
+	if (options.vis_backend == "gpu-host") {
+		gpu_vis_candidates_host(problem, candidates);
+	} else if (!gpu_vis_candidates(problem, candidates, out_error)) {
+		return false;
+	}
+
+	generate_user_vis_list_by_user(scenario, options, arena, [&](user_id_t user_i, VisScratch& scratch) {
+		scratch.candidate_slots.assign(candidates.slots.begin() + candidates.user_starts[user_i], 
+									   candidates.slots.begin() + candidates.user_starts[user_i + 1]);
+	});
+	return true;
+}
+
+// users per block and sats per tile of the tiled visibility order, see generate_user_vis_list_tiled. 
+// A tile's positions (12 bytes a sat) stay in L1 while every user of the block is tested against it
+#define VIS_TILE_USERS 64
+#define VIS_TILE_SATS 1024
+
+struct VisTileBlock {
+	/**
+	 * Up to VIS_TILE_USERS users of one sat grid cell, tile_users[begin, end) in the owning 
+	 * generate_user_vis_list_tiled 
+	 */
+	int begin; 
+	int end; 
+};
+
+template <typename Config>
+static inline void append_block_visible_sats(const Scenario& scenario, const SatGrid& sat_grid, const vector<SatBeamEntry<Config>>& sat_beam_list, 
+											 const user_id_t* block_users, int num_block_users, VisScratch& scratch, 
+											 vector<vector<int>>& user_candidates, vector<UserVisibilityEntry>& user_vis_list, 
+											 vector<sat_id_t>& out_sat_ids, vector<vector_3d_t>& out_sat_dirs) {
+	/**
+	 * append_visible_sats for every user of a block, satellite-major: the grid is queried once for 
+	 * the whole block, and each tile of VIS_TILE_SATS sats it returns is run through the mask kernel 
+	 * for every user before moving on to the next. The masks are then transposed into per-user 
+	 * candidate lists and checked exactly as append_visible_sats does, so the result is the same. 
+	 * 
+	 * Writes user_vis_list[user_i] for each block user with first_visible_sat relative to out_sat_ids. 
+	 * */
+	float cone_deg = Config::max_user_visible_angle;
+
+	// the block's mean direction, and the angle to its furthest user
+	float center[3] = {0, 0, 0};
+	for (int block_i = 0; block_i < num_block_users; block_i ++) {
+		user_id_t user_i = block_users[block_i];
+		center[0] += scenario.users.unit_xs[user_i];
+		center[1] += scenario.users.unit_ys[user_i];
+		center[2] += scenario.users.unit_zs[user_i];
+	}
+	float center_mag = sqrt(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]);
+	// users of one cell are never near opposite, but a 0 center would have no direction
+	float min_cos = center_mag > 0 ? 1.0f : -1.0f;
+	for (int block_i = 0; center_mag > 0 && block_i < num_block_users; block_i ++) {
+		user_id_t user_i = block_users[block_i];
+		float cos_user = (center[0] * scenario.users.unit_xs[user_i] + center[1] * scenario.users.unit_ys[user_i] 
+						  + center[2] * scenario.users.unit_zs[user_i]) / center_mag;
+		min_cos = MIN(min_cos, cos_user);
+	}
+	float block_radius_deg = RAD_TO_DEG(acos(MAX(-1.0f, min_cos)));
+
+	// a sat within cone_deg of a user's zenith has its direction within cone_deg of the user's, 
+	// so within cone_deg + block_radius_deg of the center's
+	vector_3d_t center_pos = {center[0], center[1], center[2]};
+	query_sat_grid(sat_grid, center_pos, cone_deg + block_radius_deg + SAT_GRID_QUERY_MARGIN_DEG, scratch.runs);
+
+	VisQuery queries[VIS_TILE_USERS];
+	for (int block_i = 0; block_i < num_block_users; block_i ++) {
+		queries[block_i] = vis_query_of(position_at(scenario.users, block_users[block_i]), cone_deg);
+		user_candidates[block_i].assign(sat_grid.unbucketed_slots.begin(), sat_grid.unbucketed_slots.end());
+	}
+	for (const SatGridRun& run : scratch.runs) {
+		for (int tile_begin = run.begin; tile_begin < run.end; tile_begin += VIS_TILE_SATS) {
+			int count = MIN(VIS_TILE_SATS, run.end - tile_begin);
+			scratch.mask.resize((count + 31) / 32);
+			for (int block_i = 0; block_i < num_block_users; block_i ++) {
+				scratch.mask_kernel(&sat_grid.xs[tile_begin], &sat_grid.ys[tile_begin], &sat_grid.zs[tile_begin], 
+									count, queries[block_i], scratch.mask.data());
+				vector<int>& candidates = user_candidates[block_i];
+				for (int word_i = 0; word_i < (int) scratch.mask.size(); word_i ++) {
+					for (uint32_t bits = scratch.mask[word_i]; bits != 0; bits &= bits - 1) {
+						candidates.push_back(sat_grid.cell_slots[tile_begin + word_i * 32 + __builtin_ctz(bits)]);
+					}
+				}
+			}
+		}
+	}
+
+	for (int block_i = 0; block_i < num_block_users; block_i ++) {
+		user_id_t user_i = block_users[block_i];
+		scratch.candidate_slots.swap(user_candidates[block_i]);
+		sort(scratch.candidate_slots.begin(), scratch.candidate_slots.end());
+		int first_visible_sat = (int) out_sat_ids.size();
+		int num_visible_sats = append_candidate_sats(scenario, sat_beam_list, user_i, scratch, out_sat_ids, out_sat_dirs);
+		user_vis_list[user_i] = {user_i, first_visible_sat, num_visible_sats};
+	}
+}
+
+template <typename Config>
+static inline void generate_user_vis_list_tiled(const Scenario& scenario, const SatGrid& sat_grid, 
+												const SolveOptions& options, SolveArena<Config>& arena) {
+	/**
+	 * generate_user_vis_list_user_major with the loops blocked the other way round. Users are 
+	 * bucketed by the sat grid cell of their direction and cut into blocks of up to VIS_TILE_USERS, 
+	 * which share one grid query and sweep its sats a tile at a time (append_block_visible_sats), 
+	 * so sat positions are loaded once per block rather than once per user. Users at ORIGIN have no 
+	 * cell and are done one at a time. 
+	 * 
+	 * Blocks are spread over options.num_threads threads, each chunk of blocks writing its sats to 
+	 * its own buffer. The buffers are then transposed into user order, so the result is the same 
+	 * as generate_user_vis_list_user_major's for any thread count. 
+	 * */
+	const vector<SatBeamEntry<Config>>& sat_beam_list = arena.sat_beam_list;
+	vector<UserVisibilityEntry>& user_vis_list = arena.user_vis_list;
+	int num_users = num_positions(scenario.users);
+	user_vis_list.resize(num_users);
+
+	// counting sort users by cell, users at ORIGIN in an extra last cell
+	int num_cells = sat_grid.num_lat_cells * sat_grid.num_lon_cells;
+	vector<int> user_cells(num_users);
+	vector<int> cell_start(num_cells + 2, 0);
+	for (user_id_t user_i = 0; user_i < num_users; user_i ++) {
+		int cell = num_cells;
+		if (scenario.users.mags[user_i] > 0) {
+			float lat, lon;
+			lat_long_of(position_at(scenario.users, user_i), &lat, &lon);
+			cell = sat_grid_lat_cell(sat_grid, lat) * sat_grid.num_lon_cells + sat_grid_lon_cell(sat_grid, lon);
+		}
+		user_cells[user_i] = cell;
+		cell_start[cell + 1] += 1;
+	}
+	for (int cell = 0; cell <= num_cells; cell ++) {
+		cell_start[cell + 1] += cell_start[cell];
+	}
+	vector<user_id_t> tile_users(num_users);
+	vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+	for (user_id_t user_i = 0; user_i < num_users; user_i ++) {
+		tile_users[fill[user_cells[user_i]] ++] = user_i;
+	}
+
+	// blocks never span cells; ORIGIN users are blocks of one
+	vector<VisTileBlock> blocks;
+	for (int cell = 0; cell <= num_cells; cell ++) {
+		int block_size = cell < num_cells ? VIS_TILE_USERS : 1;
+		for (int begin = cell_start[cell]; begin < cell_start[cell + 1]; begin += block_size) {
+			blocks.push_back({begin, MIN(cell_start[cell + 1], begin + block_size)});
+		}
+	}
+
+	int blocks_per_chunk = MAX(1, VIS_CHUNK_USERS / VIS_TILE_USERS);
+	int num_blocks = (int) blocks.size();
+	int num_chunks = (num_blocks + blocks_per_chunk - 1) / blocks_per_chunk;
+	vector<vector<sat_id_t>> chunk_sat_ids(num_chunks);
+	vector<vector<vector_3d_t>> chunk_sat_dirs(num_chunks);
+
+	parallel_for_chunks(num_chunks, options.num_threads, [&](int chunk_i) {
+		VisScratch scratch = {};
+		scratch.mask_kernel = select_vis_mask_kernel(options.use_simd);
+		vector<vector<int>> user_candidates(VIS_TILE_USERS);
+		int chunk_end = MIN(num_blocks, (chunk_i + 1) * blocks_per_chunk);
+		for (int block_i = chunk_i * blocks_per_chunk; block_i < chunk_end; block_i ++) {
+			const VisTileBlock& block = blocks[block_i];
+			const user_id_t* block_users = &tile_users[block.begin];
+			if (scenario.users.mags[block_users[0]] == 0) {
+				user_id_t user_i = block_users[0];
+				int first_visible_sat = (int) chunk_sat_ids[chunk_i].size();
+				int num_visible_sats = append_visible_sats(scenario, sat_grid, sat_beam_list, user_i, scratch, 
+														   chunk_sat_ids[chunk_i], chunk_sat_dirs[chunk_i]);
+				user_vis_list[user_i] = {user_i, first_visible_sat, num_visible_sats};
+				continue;
+			}
+			append_block_visible_sats(scenario, sat_grid, sat_beam_list, block_users, block.end - block.begin, scratch, 
+									  user_candidates, user_vis_list, chunk_sat_ids[chunk_i], chunk_sat_dirs[chunk_i]);
+		}
+	});
+
+	// transpose the chunks' sats into user order
+	vector<int> user_chunks(num_users);
+	for (int block_i = 0; block_i < num_blocks; block_i ++) {
+		for (int tile_i = blocks[block_i].begin; tile_i < blocks[block_i].end; tile_i ++) {
+			user_chunks[tile_users[tile_i]] = block_i / blocks_per_chunk;
+		}
+	}
+	size_t num_visible_total = 0;
+	for (const vector<sat_id_t>& sat_ids : chunk_sat_ids) {
+		num_visible_total += sat_ids.size();
+	}
+	vector<sat_id_t>& visible_sat_ids = arena.visible_sat_ids;
+	vector<vector_3d_t>& visible_sat_dirs = arena.visible_sat_dirs;
+	size_t first_out = visible_sat_ids.size();
+	visible_sat_ids.resize(first_out + num_visible_total);
+	visible_sat_dirs.resize(first_out + num_visible_total);
+	for (UserVisibilityEntry& entry : user_vis_list) {
+		int chunk_i = user_chunks[entry.user_id];
+		copy_n(chunk_sat_ids[chunk_i].data() + entry.first_visible_sat, entry.num_visible_sats, visible_sat_ids.data() + first_out);
+		copy_n(chunk_sat_dirs[chunk_i].data() + entry.first_visible_sat, entry.num_visible_sats, visible_sat_dirs.data() + first_out);
+		entry.first_visible_sat = (int) first_out;
+		first_out += entry.num_visible_sats;
+	}
+}
+
+template <typename Config>
+static inline void generate_user_vis_list(const Scenario& scenario, const SatGrid& sat_grid, 
+										  const SolveOptions& options, SolveArena<Config>& arena) {
+	/**
+	 * Generates arena.user_vis_list given the scenario, in the loop order options.vis_order names 
+	 * (see VIS_ORDER_NAMES) or on the GPU if options.vis_backend is "gpu" ("gpu-host" on the host). 
+	 * All give the same result. 
+	 * */
+	string gpu_error;
+	if (options.vis_backend != "cpu" && generate_user_vis_list_gpu(scenario, options, arena, gpu_error)) {
+		return;
+	}
+	if (options.vis_backend == "gpu") {
+		cerr << "GPU visibility unavailable (" << gpu_error << "), using the CPU" << endl;
+	}
+	if (options.vis_order == "tiled") {
+		generate_user_vis_list_tiled(scenario, sat_grid, options, arena);
+	} else {
+		generate_user_vis_list_user_major(scenario, sat_grid, options, arena);
+	}
+}
+
+template <typename Config>
+static inline void sort_user_vis_list(SolveArena<Config>& arena) {
+	/**
+	 * Sort visibility list ascending potential coverage (num of visible sats). A stable counting 
+	 * sort, since the key is a small int: O(# users + max key), and users with the same coverage 
+	 * keep their order, so the assignment order is the same on every standard library. 
+	 * */
+	vector<UserVisibilityEntry>& user_vis_list = arena.user_vis_list;
+	vector<int>& counts = arena.coverage_counts;
+	int max_coverage = 0;
+	for (const UserVisibilityEntry& entry : user_vis_list) {
+		max_coverage = MAX(max_coverage, entry.num_visible_sats);
+	}
+
+	// counts[c] becomes the first output index for coverage c
+	counts.assign(max_coverage + 1, 0);
+	for (const UserVisibilityEntry& entry : user_vis_list) {
+		counts[entry.num_visible_sats] += 1;
+	}
+	int first = 0;
+	for (int& count : counts) {
+		int num_entries = count;
+		count = first;
+		first += num_entries;
+	}
+
+	vector<UserVisibilityEntry>& sorted = arena.user_vis_scratch;
+	sorted.resize(user_vis_list.size());
+	for (const UserVisibilityEntry& entry : user_vis_list) {
+		sorted[counts[entry.num_visible_sats] ++] = entry;
+	}
+	user_vis_list.swap(sorted);
+}
+
+// longest line format_assignments writes, "sat <int> beam <int> user <int> color <char>\n"
+#define MAX_SOLUTION_LINE_LEN 64
+
+static inline char* append_text(char* out, const char* text) {
+	size_t len = strlen(text);
+	memcpy(out, text, len);
+	return out + len;
+}
+
+static inline void format_assignment_range(const BeamAssignment* begin, const BeamAssignment* end, string& out_text) {
+	/**
+	 * Format [begin, end) as solution lines, "sat 1 beam 1 user 1 color A", into out_text in one 
+	 * pass. ids are stored 0-indexed, so +1 for the 1-indexed spec. 
+	 * */
+	out_text.resize((end - begin) * MAX_SOLUTION_LINE_LEN);
+	char* out = &out_text[0];
+	char* out_end = out + out_text.size();
+	for (const BeamAssignment* assignment_it = begin; assignment_it != end; assignment_it ++) {
+		const BeamAssignment& assignment = *assignment_it;
+		out = append_text(out, "sat ");
+		out = to_chars(out, out_end, assignment.sat_id + 1).ptr;
+		out = append_text(out, " beam ");
+		out = to_chars(out, out_end, (int) assignment.beam_id).ptr;
+		out = append_text(out, " user ");
+		out = to_chars(out, out_end, assignment.user_id + 1).ptr;
+		out = append_text(out, " color ");
+		*out ++ = color_id_of(assignment.color_i);
+		*out ++ = '\n';
+	}
+	out_text.resize(out - &out_text[0]);
+}
+
+static inline void format_assignments(const vector<BeamAssignment>& assignments, string& out_text) {
+	format_assignment_range(assignments.data(), assignments.data() + assignments.size(), out_text);
+}
+
+static inline int open_solution_output(const string& output_path) {
+	/**
+	 * fd to write a solution to output_path through, STDOUT_FILENO if it's "", -1 (after saying so) 
+	 * if it can't be opened 
+	 * */
+	if (output_path == "") {
+		// anything already sent to cout goes first
+		cout.flush();
+		return STDOUT_FILENO;
+	}
+	int fd = open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		cout << "Couldn't open \'" << output_path << "\' for writing" << endl;
+	}
+	return fd;
+}
+
+static inline bool write_all(int fd, const char* data, size_t size) {
+	/**
+	 * Write [data, data + size) to fd with as few write calls as it allows, false on an error
+	 * */
+	size_t written = 0;
+	while (written < size) {
+		ssize_t n = write(fd, data + written, size - written);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		written += (size_t) n;
+	}
+	return true;
+}
+
+static inline bool close_solution_output(int fd, bool ok) {
+	/**
+	 * Close an open_solution_output fd, unless it's stdout. ok is whether the writes went through; 
+	 * returns false (after saying so) if they didn't or the close fails. 
+	 * */
+	if (fd != STDOUT_FILENO) {
+		ok = close(fd) == 0 && ok;
+	}
+	if (!ok) {
+		cerr << "Couldn't write solution: " << strerror(errno) << endl;
+	}
+	return ok;
+}
+
+static inline bool write_solution(const string& text, const string& output_path) {
+	/**
+	 * Write text to output_path, or stdout if it's "". Returns false (after saying so) if the 
+	 * write fails. 
+	 * */
+	int fd = open_solution_output(output_path);
+	if (fd < 0) {
+		return false;
+	}
+	return close_solution_output(fd, write_all(fd, text.data(), text.size()));
+}
+
+template <typename Config>
+static inline bool solve_scenario(const string& filename, const SolveOptions& options, Scenario& scenario, SolveArena<Config>& arena) {
+	/**
+	 * Parse scenario at filename into scenario and solve it into arena.assignments, without formatting 
+	 * any output. Both are emptied first, so they can be reused across solves. Returns false if the 
+	 * scenario couldn't be read. 
+	 * 
+	 * General flow: 
+	 * - build scenario object
+	 * - build sat_beam_list; create SatBeamEntry for sat {sat_id}
+	 * - build sat_grid; bucket sats by direction from ORIGIN
+	 * - build user_vis_list; create UserVisibilityEntry for user {users}, adding 
+	 * 							sat in {sat_id} if (visible && !non_starlink_interference)
+	 * - sort user_vis_list by coverage 
+	 * - assign beams 
+	 * */
+
+	MappedFile scenario_file;
+	if (!map_file(filename, &scenario_file)) {
+		cout << "File \'" << filename << "\' does not exist" << endl;
+		return false; 
+	}
+	clear_scenario(scenario);
+
+	// arena owns the sat beam list, which keeps track of each satellite's commited beams 
+	// used during constraint checking in solve function, and the user visibility lists
+	reset_arena(arena);
+
+	// parse the scenario, building the scenario and the sat beam list. A binary scenario is viewed 
+	// in place, so scenario keeps the file mapped until it's cleared for the next solve 
+	PROFILE_BEGIN(PROFILE_STAGE_PARSE);
+	shared_ptr<const void> mapping = share_mapping(scenario_file);
+	bool parsed = load_scenario(scenario_file.data, scenario_file.size, scenario, arena.sat_beam_list, mapping);
+	mapping.reset();
+	PROFILE_END(PROFILE_STAGE_PARSE);
+	if (!parsed) {
+		return false;
+	}
+
+	PROFILE_BEGIN(PROFILE_STAGE_GRID);
+	SatGrid sat_grid = build_sat_grid(scenario, arena.sat_beam_list);
+	PROFILE_END(PROFILE_STAGE_GRID);
+
+	PROFILE_BEGIN(PROFILE_STAGE_VISIBILITY);
+	generate_user_vis_list(scenario, sat_grid, options, arena);
+	choose_visibility_format(options, arena);
+	PROFILE_END(PROFILE_STAGE_VISIBILITY);
+
+	PROFILE_BEGIN(PROFILE_STAGE_SORT);
+	sort_user_vis_list(arena);
+	PROFILE_END(PROFILE_STAGE_SORT);
+
+	const AssignStrategy<Config>* strategy = find_assign_strategy<Config>(options.assign_strategy);
+	if (strategy == nullptr) {
+		cout << "Unknown assignment strategy \'" << options.assign_strategy << "\', expected one of " 
+			 << assign_strategy_names() << endl;
+		return false;
+	}
+	PROFILE_BEGIN(PROFILE_STAGE_ASSIGN);
+	strategy->assign(scenario, options, arena);
+	PROFILE_END(PROFILE_STAGE_ASSIGN);
+	return true;
+}
+
+// bytes of a text scenario read per call when streaming, see stream_scenario_lines
+#define STREAM_READ_BYTES (1 << 20)
+
+struct ScenarioStream {
+	/**
+	 * A scenario file read a piece at a time instead of mapped whole, see solve_scenario_streaming. 
+	 * Binary scenarios are read at the offsets their header gives, text ones through buffer. 
+	 */
+	int fd; 
+	bool binary; 
+
+	// binary scenarios only
+	BinaryScenarioHeader header; 
+
+	// text scenarios only, reused across passes
+	vector<char> buffer; 
+};
+
+static inline bool pread_all(int fd, void* out, size_t size, off_t offset) {
+	/**
+	 * Read exactly size bytes at offset into out, false on an error or a short file
+	 * */
+	size_t done = 0;
+	while (done < size) {
+		ssize_t n = pread(fd, (char*) out + done, size - done, offset + (off_t) done);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		done += (size_t) n;
+	}
+	return true;
+}
+
+static inline bool open_scenario_stream(const string& filename, ScenarioStream& stream) {
+	/**
+	 * Open filename for streaming and work out its format, false if it can't be opened
+	 * */
+	stream.fd = open(filename.c_str(), O_RDONLY);
+	if (stream.fd < 0) {
+		return false;
+	}
+	stream.header = {};
+	stream.binary = pread_all(stream.fd, &stream.header, sizeof(stream.header), 0) 
+		&& is_binary_scenario((const char*) &stream.header, sizeof(stream.header));
+	return true;
+}
+
+template <typename line_fn_t>
+static inline bool stream_scenario_lines(ScenarioStream& stream, line_fn_t line_fn) {
+	/**
+	 * parse_scenario_lines over the whole of a text scenario, from the start, reading it 
+	 * STREAM_READ_BYTES at a time. Only a line longer than the buffer grows it. 
+	 * */
+	vector<char>& buffer = stream.buffer;
+	buffer.resize(MAX(buffer.size(), (size_t) STREAM_READ_BYTES));
+	size_t filled = 0;
+	off_t offset = 0;
+	while (true) {
+		if (filled == buffer.size()) {
+			buffer.resize(buffer.size() * 2);
+		}
+		ssize_t n = pread(stream.fd, buffer.data() + filled, buffer.size() - filled, offset);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			cout << "Couldn't read scenario: " << strerror(errno) << endl;
+			return false;
+		}
+		offset += n;
+		filled += (size_t) n;
+		bool at_end = n == 0;
+
+		// parse every complete line, and at the end whatever is left
+		size_t parse_size = filled;
+		if (!at_end) {
+			const char* last_newline = (const char*) memrchr(buffer.data(), '\n', filled);
+			if (last_newline == nullptr) {
+				continue;
+			}
+			parse_size = last_newline - buffer.data() + 1;
+		}
+		if (!parse_scenario_lines(buffer.data(), parse_size, line_fn)) {
+			return false;
+		}
+		memmove(buffer.data(), buffer.data() + parse_size, filled - parse_size);
+		filled -= parse_size;
+		if (at_end) {
+			return true;
+		}
+	}
+}
+
+static inline off_t binary_scenario_field_offset(const BinaryScenarioHeader& header, int kind_i, int field_i) {
+	/**
+	 * Offset of field field_i (see position_fields) of kind kind_i (users, sats then interferers) 
+	 * in a binary scenario 
+	 * */
+	uint32_t counts[3] = {header.num_users, header.num_sats, header.num_interferers};
+	size_t offset = BINARY_SCENARIO_ALIGN;
+	for (int before_i = 0; before_i < kind_i; before_i ++) {
+		offset += POSITION_ARRAY_FIELDS * binary_scenario_array_bytes(counts[before_i]);
+	}
+	return (off_t) (offset + field_i * binary_scenario_array_bytes(counts[kind_i]));
+}
+
+template <typename Config>
+static inline bool load_stream_sats_and_interferers(ScenarioStream& stream, Scenario& scenario, vector<SatBeamEntry<Config>>& sat_beam_list) {
+	/**
+	 * Load the sats and interferers of stream into scenario, adding a SatBeamEntry for each sat to 
+	 * sat_beam_list like load_scenario, and skip its users. Returns false (after saying why) if 
+	 * the scenario is bad. 
+	 * */
+	if (!stream.binary) {
+		return stream_scenario_lines(stream, [&](string_view type, int id, vector_3d_t pos) {
+			if (type == SATS_KEY) {
+				push_position(scenario.sats, pos);
+				SatBeamEntry<Config> entry = {};
+				entry.sat_id = id - 1;
+				sat_beam_list.push_back(entry);
+			} else if (type == INTERFERER_KEY) {
+				push_position(scenario.interferers, pos);
+			}
+		});
+	}
+
+	const BinaryScenarioHeader& header = stream.header;
+	if (header.version != BINARY_SCENARIO_VERSION || header.byte_order != BINARY_SCENARIO_BYTE_ORDER) {
+		cout << "unsupported binary scenario version or byte order" << endl;
+		return false;
+	}
+	PositionArray* kinds[3] = {nullptr, &scenario.sats, &scenario.interferers};
+	uint32_t counts[3] = {header.num_users, header.num_sats, header.num_interferers};
+	for (int kind_i = 1; kind_i < 3; kind_i ++) {
+		int field_i = 0;
+		for (FloatArray* field : position_fields(*kinds[kind_i])) {
+			vector<float>& floats = owned_floats(*field);
+			floats.resize(counts[kind_i]);
+			if (!pread_all(stream.fd, floats.data(), counts[kind_i] * sizeof(float), 
+						   binary_scenario_field_offset(header, kind_i, field_i))) {
+				cout << "binary scenario is truncated" << endl;
+				return false;
+			}
+			field_i ++;
+		}
+	}
+	for (uint32_t sat_i = 0; sat_i < header.num_sats; sat_i ++) {
+		SatBeamEntry<Config> entry = {};
+		entry.sat_id = (int) sat_i;
+		sat_beam_list.push_back(entry);
+	}
+	return true;
+}
+
+template <typename chunk_fn_t>
+static inline bool for_each_user_chunk(ScenarioStream& stream, int chunk_users, PositionArray& users, chunk_fn_t chunk_fn) {
+	/**
+	 * Read the users of stream, in order, chunk_users at a time into users (emptied for each chunk), 
+	 * calling chunk_fn(first_user_id) on every chunk. Stops with false if chunk_fn returns false or 
+	 * the scenario can't be read. 
+	 * */
+	user_id_t first_user_id = 0;
+	if (!stream.binary) {
+		bool chunks_ok = true;
+		clear_positions(users);
+		bool read_ok = stream_scenario_lines(stream, [&](string_view type, int, vector_3d_t pos) {
+			if (type != USER_KEY || !chunks_ok) {
+				return;
+			}
+			push_position(users, pos);
+			if (num_positions(users) == chunk_users) {
+				chunks_ok = chunk_fn(first_user_id);
+				first_user_id += chunk_users;
+				clear_positions(users);
+			}
+		});
+		if (read_ok && chunks_ok && num_positions(users) > 0) {
+			chunks_ok = chunk_fn(first_user_id);
+		}
+		return read_ok && chunks_ok;
+	}
+
+	int num_users = (int) stream.header.num_users;
+	for (; first_user_id < num_users; first_user_id += chunk_users) {
+		int count = MIN(chunk_users, num_users - first_user_id);
+		int field_i = 0;
+		for (FloatArray* field : position_fields(users)) {
+			vector<float>& floats = owned_floats(*field);
+			floats.resize(count);
+			off_t offset = binary_scenario_field_offset(stream.header, 0, field_i) + (off_t) first_user_id * sizeof(float);
+			if (!pread_all(stream.fd, floats.data(), count * sizeof(float), offset)) {
+				cout << "binary scenario is truncated" << endl;
+				return false;
+			}
+			field_i ++;
+		}
+		if (!chunk_fn(first_user_id)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+struct SpilledUser {
+	/**
+	 * Start of a user's record in a spill file, followed by the ids of its visible sats and then 
+	 * their beam_dir_of directions. Every user in a file has as many visible sats, so records are 
+	 * fixed size, see spilled_user_bytes. 
+	 */
+	user_id_t user_id; 
+	vector_3d_t pos; 
+};
+
+static inline size_t spilled_user_bytes(int num_visible_sats) {
+	return sizeof(SpilledUser) + num_visible_sats * (sizeof(sat_id_t) + sizeof(vector_3d_t));
+}
+
+struct SpillBuckets {
+	/**
+	 * Users bucketed by their # visible sats, each bucket an unnamed temp file in dir 
+	 */ 
+	string dir; 
+
+	// files[c] holds the users with c visible sats in user order, nullptr until one is spilled, 
+	// and counts[c] how many there are
+	vector<FILE*> files; 
+	vector<int64_t> counts; 
+
+	// users with no visible sats aren't spilled, they're only counted
+	int64_t num_uncovered; 
+
+	// one chunk of records, reused for writing and reading back
+	vector<char> records; 
+};
+
+static inline FILE* open_spill_file(const string& dir) {
+	/**
+	 * A new empty temp file in dir for reading and writing, gone once it's closed 
+	 * */
+	string path = dir + "/beam_spill_XXXXXX";
+	int fd = mkstemp(&path[0]);
+	if (fd < 0) {
+		return nullptr;
+	}
+	unlink(path.c_str());
+	FILE* file = fdopen(fd, "w+b");
+	if (file == nullptr) {
+		close(fd);
+	}
+	return file;
+}
+
+static inline void close_spill_buckets(SpillBuckets& buckets) {
+	for (FILE*& file : buckets.files) {
+		if (file != nullptr) {
+			fclose(file);
+			file = nullptr;
+		}
+	}
+}
+
+template <typename Config>
+static inline bool spill_user_chunk(const Scenario& scenario, user_id_t first_user_id, const SolveArena<Config>& arena, SpillBuckets& buckets) {
+	/**
+	 * Append each user of arena.user_vis_list (one chunk, user i of scenario.users being user 
+	 * first_user_id + i) to the spill file for its # visible sats. Returns false (after saying so) 
+	 * if a file can't be written. 
+	 * */
+	for (const UserVisibilityEntry& entry : arena.user_vis_list) {
+		int num_visible_sats = entry.num_visible_sats;
+		if (num_visible_sats == 0) {
+			buckets.num_uncovered += 1;
+			continue;
+		}
+		if ((int) buckets.files.size() <= num_visible_sats) {
+			buckets.files.resize(num_visible_sats + 1, nullptr);
+			buckets.counts.resize(num_visible_sats + 1, 0);
+		}
+		FILE*& file = buckets.files[num_visible_sats];
+		if (file == nullptr) {
+			file = open_spill_file(buckets.dir);
+			if (file == nullptr) {
+				cerr << "Couldn't create a spill file in \'" << buckets.dir << "\': " << strerror(errno) << endl;
+				return false;
+			}
+		}
+
+		SpilledUser spilled = {first_user_id + entry.user_id, position_at(scenario.users, entry.user_id)};
+		buckets.records.resize(spilled_user_bytes(num_visible_sats));
+		char* record = buckets.records.data();
+		memcpy(record, &spilled, sizeof(spilled));
+		memcpy(record + sizeof(spilled), &arena.visible_sat_ids[entry.first_visible_sat], num_visible_sats * sizeof(sat_id_t));
+		memcpy(record + sizeof(spilled) + num_visible_sats * sizeof(sat_id_t), &arena.visible_sat_dirs[entry.first_visible_sat], 
+			   num_visible_sats * sizeof(vector_3d_t));
+		if (fwrite(record, buckets.records.size(), 1, file) != 1) {
+			cerr << "Couldn't write spill file: " << strerror(errno) << endl;
+			return false;
+		}
+		buckets.counts[num_visible_sats] += 1;
+	}
+	return true;
+}
+
+template <typename Config>
+static inline bool assign_spilled_users(Scenario& scenario, int chunk_users, CandidateOrder order, SpillBuckets& buckets, 
+										SolveArena<Config>& arena) {
+	/**
+	 * Greedily assign the spilled users, bucket by bucket in ascending # visible sats and in user 
+	 * order within a bucket, which is the order sort_user_vis_list puts them in. Each bucket is read 
+	 * back chunk_users at a time into scenario.users and arena, and assigned with assign_beams in 
+	 * candidate order order ("score" only sees the demand of the chunk being assigned). Closes each 
+	 * bucket once it's assigned. 
+	 * */
+	PROFILE_ADD(PROFILE_ASSIGN_USERS_UNASSIGNED, buckets.num_uncovered);
+	vector<user_id_t> chunk_user_ids;
+	for (int num_visible_sats = 1; num_visible_sats < (int) buckets.files.size(); num_visible_sats ++) {
+		FILE*& file = buckets.files[num_visible_sats];
+		if (file == nullptr) {
+			continue;
+		}
+		if (fflush(file) != 0 || fseek(file, 0, SEEK_SET) != 0) {
+			cerr << "Couldn't rewind spill file: " << strerror(errno) << endl;
+			return false;
+		}
+		size_t record_bytes = spilled_user_bytes(num_visible_sats);
+		for (int64_t remaining = buckets.counts[num_visible_sats]; remaining > 0; ) {
+			int count = (int) MIN(remaining, (int64_t) chunk_users);
+			remaining -= count;
+			buckets.records.resize(count * record_bytes);
+			if (fread(buckets.records.data(), record_bytes, count, file) != (size_t) count) {
+				cerr << "Couldn't read spill file back" << endl;
+				return false;
+			}
+
+			clear_positions(scenario.users);
+			chunk_user_ids.clear();
+			arena.user_vis_list.clear();
+			arena.visible_sat_ids.resize((size_t) count * num_visible_sats);
+			arena.visible_sat_dirs.resize((size_t) count * num_visible_sats);
+			for (int user_i = 0; user_i < count; user_i ++) {
+				const char* record = buckets.records.data() + user_i * record_bytes;
+				SpilledUser spilled;
+				memcpy(&spilled, record, sizeof(spilled));
+				int first_visible_sat = user_i * num_visible_sats;
+				memcpy(&arena.visible_sat_ids[first_visible_sat], record + sizeof(spilled), num_visible_sats * sizeof(sat_id_t));
+				memcpy(&arena.visible_sat_dirs[first_visible_sat], record + sizeof(spilled) + num_visible_sats * sizeof(sat_id_t), 
+					   num_visible_sats * sizeof(vector_3d_t));
+				push_position(scenario.users, spilled.pos);
+				chunk_user_ids.push_back(spilled.user_id);
+				arena.user_vis_list.push_back({user_i, first_visible_sat, num_visible_sats});
+			}
+
+			// the chunk's users are 0-indexed within it, switch the new beams to global ids
+			size_t first_assignment = arena.assignments.size();
+			assign_beams(scenario, arena, order);
+			for (size_t assignment_i = first_assignment; assignment_i < arena.assignments.size(); assignment_i ++) {
+				arena.assignments[assignment_i].user_id = chunk_user_ids[arena.assignments[assignment_i].user_id];
+			}
+		}
+		fclose(file);
+		file = nullptr;
+	}
+	return true;
+}
+
+template <typename Config>
+static inline bool solve_scenario_streaming(const string& filename, const SolveOptions& options, Scenario& scenario, 
+											SolveArena<Config>& arena) {
+	/**
+	 * solve_scenario for scenarios too big to hold, with the same result under the greedy strategy. 
+	 * 
+	 * Only the sats and interferers are loaded whole. Users are read options.stream_chunk_users 
+	 * at a time; each chunk gets its visibility computed and is spilled to temp files in 
+	 * options.spill_dir, one per # visible sats (see SpillBuckets). The buckets are then read back 
+	 * in ascending coverage order and assigned a chunk at a time, so memory is bounded by the sat 
+	 * state, which includes the solution, plus one chunk. scenario only ever holds one chunk of users. 
+	 * */
+	if (options.assign_strategy != "greedy") {
+		cout << "Streaming only supports the \'greedy\' assignment strategy" << endl;
+		return false;
+	}
+	ScenarioStream stream = {};
+	if (!open_scenario_stream(filename, stream)) {
+		cout << "File \'" << filename << "\' does not exist" << endl;
+		return false;
+	}
+	clear_scenario(scenario);
+	reset_arena(arena);
+
+	PROFILE_BEGIN(PROFILE_STAGE_PARSE);
+	bool ok = load_stream_sats_and_interferers(stream, scenario, arena.sat_beam_list);
+	PROFILE_END(PROFILE_STAGE_PARSE);
+	if (!ok) {
+		close(stream.fd);
+		return false;
+	}
+
+	PROFILE_BEGIN(PROFILE_STAGE_GRID);
+	SatGrid sat_grid = build_sat_grid(scenario, arena.sat_beam_list);
+	PROFILE_END(PROFILE_STAGE_GRID);
+
+	SpillBuckets buckets = {};
+	buckets.dir = options.spill_dir;
+	ok = for_each_user_chunk(stream, options.stream_chunk_users, scenario.users, [&](user_id_t first_user_id) {
+		PROFILE_BEGIN(PROFILE_STAGE_VISIBILITY);
+		arena.user_vis_list.clear();
+		arena.visible_sat_ids.clear();
+		arena.visible_sat_dirs.clear();
+		generate_user_vis_list(scenario, sat_grid, options, arena);
+		PROFILE_END(PROFILE_STAGE_VISIBILITY);
+
+		// bucketing by coverage stands in for sort_user_vis_list
+		PROFILE_BEGIN(PROFILE_STAGE_SORT);
+		bool spilled = spill_user_chunk(scenario, first_user_id, arena, buckets);
+		PROFILE_END(PROFILE_STAGE_SORT);
+		return spilled;
+	});
+	close(stream.fd);
+
+	if (ok) {
+		PROFILE_BEGIN(PROFILE_STAGE_ASSIGN);
+		ok = assign_spilled_users(scenario, options.stream_chunk_users, candidate_order_of(options), buckets, arena);
+		PROFILE_END(PROFILE_STAGE_ASSIGN);
+	}
+	close_spill_buckets(buckets);
+	return ok;
+}
+
+// parsed user batches (of VIS_CHUNK_USERS, one visibility chunk each) that may wait for the 
+// visibility workers of solve_scenario_pipelined before the parser blocks
+#define PIPELINE_QUEUE_BATCHES 64
+
+struct PipelineQueue {
+	/**
+	 * Bounded queue of the indices of parsed user batches, from the parser thread to the 
+	 * visibility workers. Guarded by lock. 
+	 */
+	mutex lock;
+	condition_variable not_empty;
+	condition_variable not_full;
+	deque<int> batches;
+	bool closed;
+};
+
+static inline void push_pipeline_batch(PipelineQueue& queue, int batch_i) {
+	unique_lock<mutex> guard(queue.lock);
+	queue.not_full.wait(guard, [&]() { return (int) queue.batches.size() < PIPELINE_QUEUE_BATCHES; });
+	queue.batches.push_back(batch_i);
+	queue.not_empty.notify_one();
+}
+
+static inline bool pop_pipeline_batch(PipelineQueue& queue, int* out_batch_i) {
+	/**
+	 * Next parsed batch, waiting for one if need be. Returns false once the queue is closed and empty. 
+	 * */
+	unique_lock<mutex> guard(queue.lock);
+	queue.not_empty.wait(guard, [&]() { return !queue.batches.empty() || queue.closed; });
+	if (queue.batches.empty()) {
+		return false;
+	}
+	*out_batch_i = queue.batches.front();
+	queue.batches.pop_front();
+	queue.not_full.notify_one();
+	return true;
+}
+
+static inline void close_pipeline_queue(PipelineQueue& queue) {
+	lock_guard<mutex> guard(queue.lock);
+	queue.closed = true;
+	queue.not_empty.notify_all();
+}
+
+template <typename Config>
+static inline bool index_text_scenario(const char* data, size_t size, Scenario& scenario, vector<SatBeamEntry<Config>>& sat_beam_list, 
+									   vector<size_t>& out_batch_starts, int* out_num_users) {
+	/**
+	 * Parse the sats and interferers of the scenario text in [data, data + size) like parse_scenario, 
+	 * and only find the user lines: out_batch_starts[b] is the offset of user line b * VIS_CHUNK_USERS, 
+	 * size ends the last batch. A line is a user line if its type is USER_KEY. 
+	 * */
+	const char* end = data + size;
+	const char* line_start = data;
+	size_t user_key_len = strlen(USER_KEY);
+	int num_users = 0;
+	out_batch_starts.clear();
+	while (line_start < end) {
+		const char* line_end = (const char*) memchr(line_start, '\n', end - line_start);
+		if (line_end == nullptr) {
+			line_end = end;
+		}
+		size_t line_len = line_end - line_start;
+		if (line_len > user_key_len && memcmp(line_start, USER_KEY, user_key_len) == 0 && line_start[user_key_len] == ' ') {
+			if (num_users % VIS_CHUNK_USERS == 0) {
+				out_batch_starts.push_back(line_start - data);
+			}
+			num_users += 1;
+		} else {
+			bool parsed = parse_scenario_lines(line_start, line_len, [&](string_view type, int id, vector_3d_t pos) {
+				if (type == SATS_KEY) {
+					push_position(scenario.sats, pos);
+					SatBeamEntry<Config> entry = {};
+					entry.sat_id = id - 1;
+					sat_beam_list.push_back(entry);
+				} else if (type == INTERFERER_KEY) {
+					push_position(scenario.interferers, pos);
+				}
+			});
+			if (!parsed) {
+				return false;
+			}
+		}
+		line_start = line_end + 1;
+	}
+	out_batch_starts.push_back(size);
+	*out_num_users = num_users;
+	return true;
+}
+
+static inline bool read_user_batch(const MappedFile& text, const vector<size_t>& batch_starts, const ScenarioStream& stream, 
+								   int batch_i, PositionArray& users) {
+	/**
+	 * Parse users [batch_i * VIS_CHUNK_USERS, ...) into their places in users (sized for all of 
+	 * them), from text if it's mapped (at batch_starts, see index_text_scenario), or else from the 
+	 * binary stream. Returns false (after saying why) if they can't be read. 
+	 * */
+	user_id_t first_user_id = batch_i * VIS_CHUNK_USERS;
+	if (text.data != nullptr) {
+		user_id_t user_i = first_user_id;
+		return parse_scenario_lines(text.data + batch_starts[batch_i], batch_starts[batch_i + 1] - batch_starts[batch_i], 
+									[&](string_view type, int, vector_3d_t pos) {
+			if (type == USER_KEY) {
+				set_position(users, user_i ++, pos);
+			}
+		});
+	}
+
+	int count = MIN(VIS_CHUNK_USERS, num_positions(users) - first_user_id);
+	int field_i = 0;
+	for (FloatArray* field : position_fields(users)) {
+		off_t offset = binary_scenario_field_offset(stream.header, 0, field_i) + (off_t) first_user_id * sizeof(float);
+		if (!pread_all(stream.fd, owned_floats(*field).data() + first_user_id, count * sizeof(float), offset)) {
+			cout << "binary scenario is truncated" << endl;
+			return false;
+		}
+		field_i ++;
+	}
+	return true;
+}
+
+template <typename Config>
+static inline bool solve_scenario_pipelined(const string& filename, const string& output_path, const SolveOptions& options, 
+											Scenario& scenario, SolveArena<Config>& arena) {
+	/**
+	 * solve_scenario plus writing the solution to output_path ("" for stdout), with the stages 
+	 * overlapped, for the same solution. 
+	 * 
+	 * The sats and interferers are loaded first, along with a cheap scan that finds how many 
+	 * users there are. A parser thread then parses users a batch (visibility chunk) at a time 
+	 * into place and hands each through a bounded PipelineQueue to the visibility workers, 
+	 * MAX(1, options.num_threads - 1) of them, which compute it in user-major order while later 
+	 * batches are being parsed. That's always the CPU's user-major gather: options.vis_order and 
+	 * options.vis_backend are ignored, since the tiled order and the GPU both work on every user 
+	 * at once, and the command line rejects them with --pipeline. 
+	 * 
+	 * After the sort, which needs every user, a writer thread formats and writes assignments as 
+	 * the greedy strategy publishes them (AssignmentFeed). Other strategies can revise earlier 
+	 * beams, so their solution is written once they're done. 
+	 * */
+	const AssignStrategy<Config>* strategy = find_assign_strategy<Config>(options.assign_strategy);
+	if (strategy == nullptr) {
+		cout << "Unknown assignment strategy \'" << options.assign_strategy << "\', expected one of " 
+			 << assign_strategy_names() << endl;
+		return false;
+	}
+	ScenarioStream stream = {};
+	if (!open_scenario_stream(filename, stream)) {
+		cout << "File \'" << filename << "\' does not exist" << endl;
+		return false;
+	}
+	clear_scenario(scenario);
+	reset_arena(arena);
+
+	// text is mapped and indexed, binary is read at the offsets its header gives
+	PROFILE_BEGIN(PROFILE_STAGE_PARSE);
+	MappedFile text = {};
+	vector<size_t> batch_starts;
+	int num_users = 0;
+	bool ok = true;
+	if (stream.binary) {
+		ok = load_stream_sats_and_interferers(stream, scenario, arena.sat_beam_list);
+		num_users = (int) stream.header.num_users;
+	} else {
+		ok = map_file(filename, &text) && index_text_scenario(text.data, text.size, scenario, arena.sat_beam_list, batch_starts, &num_users);
+	}
+	PROFILE_END(PROFILE_STAGE_PARSE);
+	if (!ok) {
+		if (text.data != nullptr) {
+			unmap_file(text);
+		}
+		close(stream.fd);
+		return false;
+	}
+
+	PROFILE_BEGIN(PROFILE_STAGE_GRID);
+	SatGrid sat_grid = build_sat_grid(scenario, arena.sat_beam_list);
+	PROFILE_END(PROFILE_STAGE_GRID);
+
+	// parse and visibility overlap, so both count as visibility
+	PROFILE_BEGIN(PROFILE_STAGE_VISIBILITY);
+	resize_positions(scenario.users, num_users);
+	arena.user_vis_list.resize(num_users);
+	int num_batches = (num_users + VIS_CHUNK_USERS - 1) / VIS_CHUNK_USERS;
+	vector<vector<sat_id_t>> chunk_sat_ids(num_batches);
+	vector<vector<vector_3d_t>> chunk_sat_dirs(num_batches);
+	PipelineQueue queue;
+	queue.closed = false;
+	bool parse_ok = true;
+	thread parser([&]() {
+		for (int batch_i = 0; batch_i < num_batches && parse_ok; batch_i ++) {
+			parse_ok = read_user_batch(text, batch_starts, stream, batch_i, scenario.users);
+			if (parse_ok) {
+				push_pipeline_batch(queue, batch_i);
+			}
+		}
+		close_pipeline_queue(queue);
+	});
+	int num_workers = MAX(1, options.num_threads - 1);
+	parallel_for_chunks(num_workers, num_workers, [&](int) {
+		VisScratch scratch = {};
+		scratch.mask_kernel = select_vis_mask_kernel(options.use_simd);
+		auto gather_fn = [&](user_id_t user_i, VisScratch& user_scratch) {
+			gather_candidate_slots(sat_grid, position_at(scenario.users, user_i), Config::max_user_visible_angle, user_scratch);
+		};
+		for (int batch_i; pop_pipeline_batch(queue, &batch_i); ) {
+			append_chunk_visible_sats(scenario, arena.sat_beam_list, batch_i, scratch, gather_fn, arena.user_vis_list, 
+									  chunk_sat_ids[batch_i], chunk_sat_dirs[batch_i]);
+		}
+	});
+	parser.join();
+	if (text.data != nullptr) {
+		unmap_file(text);
+	}
+	close(stream.fd);
+	if (!parse_ok) {
+		PROFILE_END(PROFILE_STAGE_VISIBILITY);
+		return false;
+	}
+	stitch_chunk_visible_sats(num_users, chunk_sat_ids, chunk_sat_dirs, arena);
+	choose_visibility_format(options, arena);
+	PROFILE_END(PROFILE_STAGE_VISIBILITY);
+
+	PROFILE_BEGIN(PROFILE_STAGE_SORT);
+	sort_user_vis_list(arena);
+	PROFILE_END(PROFILE_STAGE_SORT);
+
+	int fd = open_solution_output(output_path);
+	if (fd < 0) {
+		return false;
+	}
+	AssignmentFeed feed;
+	feed.assignments = nullptr;
+	feed.num_published = 0;
+	feed.done = false;
+	bool write_ok = true;
+	thread writer([&]() {
+		string text;
+		size_t num_written = 0;
+		bool done = false;
+		while (!done) {
+			const BeamAssignment* assignments;
+			size_t num_published;
+			{
+				unique_lock<mutex> guard(feed.lock);
+				feed.published_cv.wait(guard, [&]() { return feed.num_published > num_written || feed.done; });
+				assignments = feed.assignments;
+				num_published = feed.num_published;
+				done = feed.done;
+			}
+			format_assignment_range(assignments + num_written, assignments + num_published, text);
+			write_ok = write_all(fd, text.data(), text.size()) && write_ok;
+			num_written = num_published;
+		}
+	});
+
+	// writing overlaps assignment, so both count as assignment
+	PROFILE_BEGIN(PROFILE_STAGE_ASSIGN);
+	if (options.assign_strategy == "greedy") {
+		assign_beams(scenario, arena, candidate_order_of(options), &feed);
+	} else {
+		strategy->assign(scenario, options, arena);
+		publish_assignments(feed, arena.assignments, true);
+	}
+	writer.join();
+	PROFILE_END(PROFILE_STAGE_ASSIGN);
+	return close_solution_output(fd, write_ok);
+}
+
+template <typename Config>
+static inline bool solve_and_write(const string& filename, const string& output_path, const SolveOptions& options, 
+								   Scenario& scenario, SolveArena<Config>& arena, string& solution_text) {
+	/**
+	 * Solve the scenario at filename, streaming or pipelining it if options say so, and write the 
+	 * solution to output_path ("" for stdout). scenario, arena and solution_text are scratch, reused 
+	 * by the caller across solves. Returns false if either step fails. 
+	 * */
+	if (options.pipeline && options.stream_chunk_users == 0) {
+		return solve_scenario_pipelined(filename, output_path, options, scenario, arena);
+	}
+	bool solved = options.stream_chunk_users > 0 ? solve_scenario_streaming(filename, options, scenario, arena) 
+		: solve_scenario(filename, options, scenario, arena);
+	if (!solved) {
+		return false;
+	}
+
+	PROFILE_BEGIN(PROFILE_STAGE_OUTPUT);
+	format_assignments(arena.assignments, solution_text);
+	bool written = write_solution(solution_text, output_path);
+	PROFILE_END(PROFILE_STAGE_OUTPUT);
+	return written;
+}
+
+template <typename Config>
+static inline void solve_config(const string& filename, const SolveOptions& options) {
+	Scenario scenario = {};
+	SolveArena<Config> arena = {};
+	string solution_text = "";
+	solve_and_write(filename, options.output_path, options, scenario, arena, solution_text);
+}
+
+inline void solve(const string& filename, const SolveOptions& options) {
+	/**
+	 * Solve the scenario at filename with the config options.config and write the solution to 
+	 * options.output_path, or stdout if it's empty. A PROFILE build then reports its profile, 
+	 * see profile.h 
+	 * */
+	bool found = with_solver_config(options.config, [&](auto config) {
+		solve_config<decltype(config)>(filename, options);
+	});
+	if (!found) {
+		cout << "Unknown config \'" << options.config << "\', expected one of " << solver_config_names() << endl;
+		return;
+	}
+
+#ifdef PROFILE
+	if (options.profile_json_path != "") {
+		write_solution(profile_summary_json(), options.profile_json_path);
+	} else {
+		print_profile_summary();
+	}
+#else
+	if (options.profile_json_path != "") {
+		cerr << "--profile-json needs a PROFILE=1 build, no profile written" << endl;
+	}
+#endif
+}
+
+#endif // SOLVER_H
@@ -0,0 +1,182 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include "solver.h"
+#include <random>
+
+/**
+ * Synthetic scenarios: a Walker delta shell of sats, users scattered over latitude bands, and
+ * interferers evenly spaced around the GEO belt (like 10_ten_thousand_users_geo_belt). Used by
+ * bench.cpp's synthetic cases and scaling sweep, and written to files by generate_scenario.cpp.
+ *
+ * Typical use:
+ * 		WalkerParams params = default_walker_params();
+ * 		params.num_users = 1000000;
+ * 		string text = walker_scenario_text(params);
+ * */
+
+#define EARTH_RADIUS_KM 6371.0
+#define GEO_RADIUS_KM 42164.0
+
+struct LatitudeBand {
+	/**
+	 * Users between min_lat_deg and max_lat_deg, weight their relative density per unit area
+	 */
+	double min_lat_deg;
+	double max_lat_deg;
+	double weight;
+};
+
+struct WalkerParams {
+	// Walker delta i:t/p/f, t = num_planes * sats_per_plane
+	int num_planes;
+	int sats_per_plane;
+	int phasing;
+	double inclination_deg;
+	double altitude_km;
+
+	// users are uniform on the sphere within each band, bands picked by weight * area
+	int num_users;
+	vector<LatitudeBand> user_bands;
+
+	// evenly spaced around the GEO belt
+	int num_interferers;
+
+	unsigned seed;
+};
+
+static inline WalkerParams default_walker_params() {
+	/**
+	 * The 72 x 20 shell at 53 deg and 550 km of 11_one_hundred_thousand_users, 10k users between
+	 * +-60 deg latitude and 36 GEO interferers
+	 * */
+	WalkerParams params = {};
+	params.num_planes = 72;
+	params.sats_per_plane = 20;
+	params.phasing = 1;
+	params.inclination_deg = 53.0;
+	params.altitude_km = 550.0;
+	params.num_users = 10000;
+	params.user_bands = {{-60.0, 60.0, 1.0}};
+	params.num_interferers = 36;
+	params.seed = 1;
+	return params;
+}
+
+static inline bool parse_latitude_band(const string& text, LatitudeBand* out) {
+	/**
+	 * "MIN:MAX" or "MIN:MAX:WEIGHT" in degrees, weight 1 if not given. Returns false unless
+	 * -90 <= MIN < MAX <= 90 and WEIGHT > 0.
+	 * */
+	LatitudeBand band = {0.0, 0.0, 1.0};
+	int num_read = sscanf(text.c_str(), "%lf:%lf:%lf", &band.min_lat_deg, &band.max_lat_deg, &band.weight);
+	if (num_read < 2 || band.min_lat_deg < -90.0 || band.max_lat_deg > 90.0 || band.min_lat_deg >= band.max_lat_deg
+		|| band.weight <= 0) {
+		return false;
+	}
+	*out = band;
+	return true;
+}
+
+template <typename object_fn_t>
+static inline void generate_walker_scenario(const WalkerParams& params, object_fn_t object_fn) {
+	/**
+	 * Calls object_fn(type, id, x, y, z) for every object of the scenario params describes, in file
+	 * order: users, then sats, then interferers, ids from 1
+	 * */
+	mt19937 rng(params.seed);
+	uniform_real_distribution<double> unit(0.0, 1.0);
+
+	// a band's share of users is its weight times its area, which is proportional to its z extent
+	int num_bands = (int) params.user_bands.size();
+	vector<double> band_cdf(num_bands);
+	double total_share = 0;
+	for (int band_i = 0; band_i < num_bands; band_i ++) {
+		const LatitudeBand& band = params.user_bands[band_i];
+		total_share += band.weight * (sin(DEG_TO_RAD(band.max_lat_deg)) - sin(DEG_TO_RAD(band.min_lat_deg)));
+		band_cdf[band_i] = total_share;
+	}
+	for (int user_i = 0; num_bands > 0 && user_i < params.num_users; user_i ++) {
+		// with one band no draw is spent picking it
+		int band_i = 0;
+		if (num_bands > 1) {
+			double pick = unit(rng) * total_share;
+			band_i = (int) (lower_bound(band_cdf.begin(), band_cdf.end(), pick) - band_cdf.begin());
+			band_i = MIN(band_i, num_bands - 1);
+		}
+		const LatitudeBand& band = params.user_bands[band_i];
+
+		// uniform on the sphere, restricted to the band
+		double min_z = sin(DEG_TO_RAD(band.min_lat_deg));
+		double max_z = sin(DEG_TO_RAD(band.max_lat_deg));
+		double z = min_z + unit(rng) * (max_z - min_z);
+		double lon = 2.0 * M_PI * unit(rng);
+		double xy = sqrt(MAX(0.0, 1.0 - z * z));
+		object_fn(USER_KEY, user_i + 1, EARTH_RADIUS_KM * xy * cos(lon), EARTH_RADIUS_KM * xy * sin(lon), EARTH_RADIUS_KM * z);
+	}
+
+	double sat_radius = EARTH_RADIUS_KM + params.altitude_km;
+	double inclination = DEG_TO_RAD(params.inclination_deg);
+	int num_planes = params.num_planes;
+	int sats_per_plane = params.sats_per_plane;
+	int num_sats = num_planes * sats_per_plane;
+	for (int plane_i = 0; plane_i < num_planes; plane_i ++) {
+		double raan = 2.0 * M_PI * plane_i / num_planes;
+		for (int slot_i = 0; slot_i < sats_per_plane; slot_i ++) {
+			double anomaly = 2.0 * M_PI * slot_i / sats_per_plane + 2.0 * M_PI * params.phasing * plane_i / num_sats;
+			// position in the orbital plane, tilted by inclination about x, then rotated by raan about z
+			double px = cos(anomaly);
+			double py = sin(anomaly) * cos(inclination);
+			double pz = sin(anomaly) * sin(inclination);
+			object_fn(SATS_KEY, plane_i * sats_per_plane + slot_i + 1,
+					  sat_radius * (px * cos(raan) - py * sin(raan)),
+					  sat_radius * (px * sin(raan) + py * cos(raan)),
+					  sat_radius * pz);
+		}
+	}
+
+	for (int int_i = 0; int_i < params.num_interferers; int_i ++) {
+		double lon = 2.0 * M_PI * int_i / params.num_interferers;
+		object_fn(INTERFERER_KEY, int_i + 1, GEO_RADIUS_KM * cos(lon), GEO_RADIUS_KM * sin(lon), 0.0);
+	}
+}
+
+// longest line append_object_line writes, with coordinates up to GEO distance
+#define MAX_OBJECT_LINE_LEN 128
+
+static inline void append_object_line(string& text, const char* type, int id, double x, double y, double z) {
+	char line[MAX_OBJECT_LINE_LEN];
+	snprintf(line, sizeof(line), "%s %d %.6f %.6f %.6f\n", type, id, x, y, z);
+	text += line;
+}
+
+static inline string walker_scenario_header(const WalkerParams& params) {
+	/**
+	 * '#' comment lines describing params, like the test cases open with
+	 * */
+	char buff[256];
+	snprintf(buff, sizeof(buff), "# Walker delta %.1f:%d/%d/%d shell at %.1f km\n# %d Satellites\n# %d Users\n# %d Interferers\n",
+			 params.inclination_deg, params.num_planes * params.sats_per_plane, params.num_planes, params.phasing,
+			 params.altitude_km, params.num_planes * params.sats_per_plane, params.num_users, params.num_interferers);
+	string header = buff;
+	for (const LatitudeBand& band : params.user_bands) {
+		snprintf(buff, sizeof(buff), "# users between %.1f and %.1f deg latitude, weight %g\n",
+				 band.min_lat_deg, band.max_lat_deg, band.weight);
+		header += buff;
+	}
+	return header;
+}
+
+static inline string walker_scenario_text(const WalkerParams& params) {
+	/**
+	 * The scenario params describes as text, see generate_walker_scenario
+	 * */
+	string text = walker_scenario_header(params);
+	text.reserve(text.size() + (size_t) (params.num_users + params.num_planes * params.sats_per_plane + params.num_interferers) * 48);
+	generate_walker_scenario(params, [&](const char* type, int id, double x, double y, double z) {
+		append_object_line(text, type, id, x, y, z);
+	});
+	return text;
+}
+
+#endif // SYNTHETIC_H
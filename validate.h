@@ -0,0 +1,524 @@
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include "solver.h"
+
+/**
+ * Native replacement for evaluate.py. Reads a scenario and a solution, runs evaluate.py's checks
+ * in the same order (coverage, visibility, self-interference, interferers) and prints the same
+ * report. The solver's float kernels, the beam direction prefilter and the per-user interferer
+ * cones, only rule out pairs that are clear of a threshold by more than their margins, so the
+ * O(beams x interferers) scan that dominates evaluate.py becomes a handful of dot products per
+ * beam. Every pair they don't rule out is decided by python_angle_within, evaluate.py's own
+ * arithmetic on positions parsed to double like it parses them, so the verdict, and the angle
+ * printed with a violation, are evaluate.py's bit for bit.
+ *
+ * Beams are checked in evaluate.py's order (sats by first appearance, each sat's beams in file
+ * order), so the first violation reported is the same one it would report.
+ *
+ * Typical use:
+ * 		./solution --validate /path/to/scenario.txt [/path/to/solution.txt]
+ * */
+
+static inline string format_python_float(double value) {
+	/**
+	 * value as python's str(float) prints it: the shortest digits that round trip, in positional
+	 * notation with ".0" on integral values for 1e-4 <= |value| < 1e16, and scientific notation
+	 * ("1e-05", "1.5e+16") outside that
+	 * */
+	// shortest round trip in scientific notation, split into sign, digits and exponent
+	char buff[64];
+#if defined(__cpp_lib_to_chars)
+	string sci(buff, to_chars(buff, buff + sizeof(buff), value, chars_format::scientific).ptr);
+#else
+	// no floating point to_chars before libstdc++ 11, take the fewest digits that round trip
+	string sci;
+	for (int decimals = 0; decimals <= 16; decimals ++) {
+		snprintf(buff, sizeof(buff), "%.*e", decimals, value);
+		sci = buff;
+		if (strtod(buff, nullptr) == value) {
+			break;
+		}
+	}
+#endif
+	size_t e_pos = sci.find('e');
+	if (e_pos == string::npos) {
+		// inf and nan, spelled the same
+		return sci;
+	}
+	string sign = sci[0] == '-' ? "-" : "";
+	string digits = "";
+	for (size_t i = sign.size(); i < e_pos; i ++) {
+		if (sci[i] != '.') {
+			digits += sci[i];
+		}
+	}
+	int exponent = atoi(sci.c_str() + e_pos + 1);
+	if (value == 0) {
+		exponent = 0;
+	}
+
+	if (exponent < -4 || exponent >= 16) {
+		string mantissa = digits.substr(0, 1) + (digits.size() > 1 ? "." + digits.substr(1) : "");
+		snprintf(buff, sizeof(buff), "e%c%02d", exponent < 0 ? '-' : '+', abs(exponent));
+		return sign + mantissa + buff;
+	}
+	if (exponent < 0) {
+		return sign + "0." + string(-exponent - 1, '0') + digits;
+	}
+	if ((int) digits.size() <= exponent + 1) {
+		return sign + digits + string(exponent + 1 - digits.size(), '0') + ".0";
+	}
+	return sign + digits.substr(0, exponent + 1) + "." + digits.substr(exponent + 1);
+}
+
+using exact_vector_3d_t = array<double, 3>;
+
+static const exact_vector_3d_t EXACT_ORIGIN = {0, 0, 0};
+
+// -ffast-math would reassociate evaluate.py's sums and turn its divisions into reciprocal
+// multiplies, and GCC's default -ffp-contract=fast would fuse a * b + c into an FMA where the target
+// has one (aarch64 always does), so the exact angle is built without either. Other compilers need a
+// FAST_MATH=0 build, which also turns contraction off
+#if defined(__GNUC__) && !defined(__clang__)
+#define PYTHON_EXACT_MATH __attribute__((optimize("no-fast-math,fp-contract=off")))
+#else
+#define PYTHON_EXACT_MATH
+#endif
+
+PYTHON_EXACT_MATH static inline bool python_angle_within(const exact_vector_3d_t& vertex, const exact_vector_3d_t& point_a,
+														 const exact_vector_3d_t& point_b, double max_deg, bool or_equal, double* out_angle) {
+	/**
+	 * evaluate.py's calculate_angle_degrees(vertex, point_a, point_b) < max_deg (<= if or_equal),
+	 * operation for operation, with the angle in out_angle. Where evaluate.py would divide by zero,
+	 * a point on the vertex, the angle is 0 and never within.
+	 * */
+	double va[3] = {point_a[0] - vertex[0], point_a[1] - vertex[1], point_a[2] - vertex[2]};
+	double vb[3] = {point_b[0] - vertex[0], point_b[1] - vertex[1], point_b[2] - vertex[2]};
+
+	// x ** 2 is pow(x, 2), which is x * x exactly
+	double va_mag = sqrt(va[0] * va[0] + va[1] * va[1] + va[2] * va[2]);
+	double vb_mag = sqrt(vb[0] * vb[0] + vb[1] * vb[1] + vb[2] * vb[2]);
+	if (va_mag == 0 || vb_mag == 0) {
+		*out_angle = 0;
+		return false;
+	}
+	double dot_product = (va[0] / va_mag) * (vb[0] / vb_mag) + (va[1] / va_mag) * (vb[1] / vb_mag)
+		+ (va[2] / va_mag) * (vb[2] / vb_mag);
+	double dot_product_bound = min(1.0, max(-1.0, dot_product));
+
+	// math.degrees multiplies by 180 / pi
+	*out_angle = acos(dot_product_bound) * (180.0 / M_PI);
+	return or_equal ? *out_angle <= max_deg : *out_angle < max_deg;
+}
+
+static inline exact_vector_3d_t exact_vector_of(vector_3d_t pos) {
+	return {(double) pos[0], (double) pos[1], (double) pos[2]};
+}
+
+struct ValidationScenario {
+	/**
+	 * A scenario as the validator reads it: each position in double, as evaluate.py parses the
+	 * text, for the final decisions, and as float in scenario for the solver's prefilters
+	 */
+	Scenario scenario;
+	vector<exact_vector_3d_t> users;
+	vector<exact_vector_3d_t> sats;
+	vector<exact_vector_3d_t> interferers;
+};
+
+static inline void validation_scenario_of(const Scenario& scenario, ValidationScenario& out) {
+	/**
+	 * out for a scenario that only has float positions, e.g. a binary one or a Planner's, which
+	 * evaluate.py would see written out exactly
+	 * */
+	out = {};
+	out.scenario = scenario;
+	const PositionArray* kinds[3] = {&scenario.users, &scenario.sats, &scenario.interferers};
+	vector<exact_vector_3d_t>* exact_kinds[3] = {&out.users, &out.sats, &out.interferers};
+	for (int kind_i = 0; kind_i < 3; kind_i ++) {
+		for (int i = 0; i < num_positions(*kinds[kind_i]); i ++) {
+			exact_kinds[kind_i]->push_back(exact_vector_of(position_at(*kinds[kind_i], i)));
+		}
+	}
+}
+
+template <typename Config>
+static inline bool load_validation_scenario(const char* data, size_t size, ValidationScenario& out) {
+	/**
+	 * Load a scenario in either format into out, see load_scenario
+	 * */
+	out = {};
+	if (is_binary_scenario(data, size)) {
+		Scenario scenario = {};
+		vector<SatBeamEntry<Config>> sat_beam_list;
+		if (!load_binary_scenario(data, size, scenario, sat_beam_list)) {
+			return false;
+		}
+		validation_scenario_of(scenario, out);
+		return true;
+	}
+	return parse_scenario_lines<double>(data, size, [&](string_view type, int, exact_vector_3d_t pos) {
+		vector_3d_t float_pos = {(float) pos[0], (float) pos[1], (float) pos[2]};
+		if (type == USER_KEY) {
+			push_position(out.scenario.users, float_pos);
+			out.users.push_back(pos);
+		} else if (type == SATS_KEY) {
+			push_position(out.scenario.sats, float_pos);
+			out.sats.push_back(pos);
+		} else if (type == INTERFERER_KEY) {
+			push_position(out.scenario.interferers, float_pos);
+			out.interferers.push_back(pos);
+		}
+	});
+}
+
+static inline bool parse_solution_id(string_view token, int max_id, int* out) {
+	/**
+	 * Parse a 1-indexed id in [1, max_id], written exactly as evaluate.py expects it: digits
+	 * only, no sign or leading zeros
+	 * */
+	if (token.empty() || token[0] == '0' || token.size() > 10) {
+		return false;
+	}
+	for (char c : token) {
+		if (c < '0' || c > '9') {
+			return false;
+		}
+	}
+	long long id = 0;
+	from_chars(token.data(), token.data() + token.size(), id);
+	if (id < 1 || id > max_id) {
+		return false;
+	}
+	*out = (int) id;
+	return true;
+}
+
+template <typename Config>
+static inline bool parse_solution(const char* data, size_t size, const Scenario& scenario, vector<BeamAssignment>& out_assignments) {
+	/**
+	 * Parse the solution text in [data, data + size) into out_assignments, in the order
+	 * evaluate.py iterates its solution dict: grouped by sat in order of each sat's first line,
+	 * then by line. Lines with a '#' anywhere and blank lines are skipped; every other line must
+	 * be "sat <id> beam <id> user <id> color <id>" split on any whitespace. On a bad line prints
+	 * evaluate.py's message and returns false.
+	 * */
+	int num_sats = num_positions(scenario.sats);
+	int num_users = num_positions(scenario.users);
+	vector<uint8_t> beam_taken((size_t) num_sats * Config::beams_per_satellite, 0);
+	vector<BeamAssignment> assignments;
+
+	// each sat's position in order of first appearance
+	vector<int> sat_rank(num_sats, -1);
+	int num_ranked = 0;
+
+	const char* end = data + size;
+	const char* line_start = data;
+	while (line_start < end) {
+		const char* line_end = (const char*) memchr(line_start, '\n', end - line_start);
+		if (line_end == nullptr) {
+			line_end = end;
+		}
+		string_view line(line_start, line_end - line_start);
+
+		// the line as evaluate.py echoes it on errors, with its newline
+		string_view raw_line(line_start, line_end - line_start + (line_end < end ? 1 : 0));
+		line_start = line_end + 1;
+
+		if (line.find('#') != string_view::npos) {
+			continue;
+		}
+
+		// split on runs of whitespace, counting every field but keeping only the first 8
+		string_view parts[8];
+		int num_parts = 0;
+		size_t pos = 0;
+		while (true) {
+			pos = line.find_first_not_of(" \t\r\v\f", pos);
+			if (pos == string_view::npos) {
+				break;
+			}
+			size_t part_end = line.find_first_of(" \t\r\v\f", pos);
+			if (num_parts < 8) {
+				parts[num_parts] = line.substr(pos, part_end == string_view::npos ? string_view::npos : part_end - pos);
+			}
+			num_parts ++;
+			pos = part_end;
+		}
+
+		if (num_parts == 0) {
+			continue;
+		}
+		if (num_parts != 8 || parts[0] != "sat" || parts[2] != "beam" || parts[4] != "user" || parts[6] != "color") {
+			cout << "Invalid line! " << raw_line << endl;
+			return false;
+		}
+
+		int sat_id, beam_id, user_id;
+		if (!parse_solution_id(parts[1], num_sats, &sat_id)) {
+			cout << "Referenced an invalid sat id! " << raw_line << endl;
+			return false;
+		}
+		if (!parse_solution_id(parts[5], num_users, &user_id)) {
+			cout << "Referenced an invalid user id! " << raw_line << endl;
+			return false;
+		}
+		if (!parse_solution_id(parts[3], Config::beams_per_satellite, &beam_id)) {
+			cout << "Referenced an invalid beam id! " << raw_line << endl;
+			return false;
+		}
+		int color_i = parts[7].size() == 1 ? parts[7][0] - color_id_of(0) : -1;
+		if (color_i < 0 || color_i >= Config::colors_per_satellite) {
+			cout << "Referenced an invalid color! " << raw_line << endl;
+			return false;
+		}
+
+		uint8_t& taken = beam_taken[(size_t) (sat_id - 1) * Config::beams_per_satellite + beam_id - 1];
+		if (taken) {
+			cout << "Beam is allocated multiple times! " << raw_line << endl;
+			return false;
+		}
+		taken = 1;
+		if (sat_rank[sat_id - 1] < 0) {
+			sat_rank[sat_id - 1] = num_ranked ++;
+		}
+		assignments.push_back({sat_id - 1, user_id - 1, (uint8_t) beam_id, (uint8_t) color_i});
+	}
+
+	// stable counting sort by sat rank
+	vector<int> counts(num_ranked + 1, 0);
+	for (const BeamAssignment& assignment : assignments) {
+		counts[sat_rank[assignment.sat_id] + 1] ++;
+	}
+	for (int rank = 0; rank < num_ranked; rank ++) {
+		counts[rank + 1] += counts[rank];
+	}
+	out_assignments.resize(assignments.size());
+	for (const BeamAssignment& assignment : assignments) {
+		out_assignments[counts[sat_rank[assignment.sat_id]] ++] = assignment;
+	}
+	return true;
+}
+
+static inline bool check_user_coverage(const ValidationScenario& scenario, const vector<BeamAssignment>& assignments) {
+	/**
+	 * No user has more than one beam. Reports the % of users covered.
+	 * */
+	cout << "Checking user coverage..." << endl;
+	int num_users = (int) scenario.users.size();
+	vector<uint8_t> covered(num_users, 0);
+	for (const BeamAssignment& assignment : assignments) {
+		if (covered[assignment.user_id]) {
+			cout << "\tUser " << assignment.user_id + 1 << " is covered multiple times by solution!" << endl;
+			return false;
+		}
+		covered[assignment.user_id] = 1;
+	}
+	double covered_pct = ((double) assignments.size() / num_users) * 100;
+	cout << format_python_float(covered_pct) << "% of " << num_users << " total users covered." << endl;
+	return true;
+}
+
+template <typename Config>
+static inline bool check_user_visibility(const ValidationScenario& scenario, const vector<BeamAssignment>& assignments) {
+	/**
+	 * Every user can see the sat serving it. One angle per beam, so there's nothing to prefilter.
+	 * */
+	cout << "Checking each user can see their assigned satellite..." << endl;
+	for (const BeamAssignment& assignment : assignments) {
+		double angle;
+		if (python_angle_within(scenario.users[assignment.user_id], EXACT_ORIGIN, scenario.sats[assignment.sat_id],
+								180.0 - Config::max_user_visible_angle, true, &angle)) {
+			double elevation = angle - 90;
+			cout << "\tSat " << assignment.sat_id + 1 << " outside of user " << assignment.user_id + 1 << "'s field of view." << endl;
+			cout << "\t\t" << format_python_float(elevation) << " degrees elevation." << endl;
+			cout << "\t\t(Min: " << format_python_float(90 - Config::max_user_visible_angle) << " degrees elevation.)" << endl;
+			return false;
+		}
+	}
+	cout << "\tAll users' assigned satellites are visible." << endl;
+	return true;
+}
+
+template <typename Config>
+static inline bool check_self_interference(const ValidationScenario& scenario, const vector<BeamAssignment>& assignments) {
+	/**
+	 * No two same-colored beams of a sat are within self_interference_max of each other. Relies on
+	 * parse_solution grouping each sat's beams together. Pairs whose float beam directions are
+	 * SELF_INTERFERENCE_COS_MARGIN clear of the threshold are skipped, the rest decided exactly.
+	 * */
+	cout << "Checking no sat interferes with itself..." << endl;
+	vector_3d_t beam_dirs[Config::beams_per_satellite];
+	for (size_t group_start = 0; group_start < assignments.size(); ) {
+		sat_id_t sat_i = assignments[group_start].sat_id;
+		vector_3d_t sat_pos = position_at(scenario.scenario.sats, sat_i);
+		size_t group_end = group_start;
+		for (; group_end < assignments.size() && assignments[group_end].sat_id == sat_i; group_end ++) {
+			vector_3d_t user_pos = position_at(scenario.scenario.users, assignments[group_end].user_id);
+			beam_dirs[group_end - group_start] = beam_dir_of(sat_pos, user_pos);
+		}
+
+		for (size_t i = group_start; i < group_end; i ++) {
+			const vector_3d_t& dir_a = beam_dirs[i - group_start];
+			for (size_t j = i + 1; j < group_end; j ++) {
+				if (assignments[i].color_i != assignments[j].color_i) {
+					continue;
+				}
+				const vector_3d_t& dir_b = beam_dirs[j - group_start];
+				float cos_angle = dir_a[0] * dir_b[0] + dir_a[1] * dir_b[1] + dir_a[2] * dir_b[2];
+				if (cos_angle <= Config::cos_self_interference_max - SELF_INTERFERENCE_COS_MARGIN) {
+					continue;
+				}
+				double angle;
+				if (python_angle_within(scenario.sats[sat_i], scenario.users[assignments[i].user_id], scenario.users[assignments[j].user_id],
+										Config::self_interference_max, false, &angle)) {
+					cout << "\tSat " << sat_i + 1 << " beams " << (int) assignments[i].beam_id << " and "
+						 << (int) assignments[j].beam_id << " interfere." << endl;
+					cout << "\t\tBeam angle: " << format_python_float(angle) << " degrees." << endl;
+					return false;
+				}
+			}
+		}
+		group_start = group_end;
+	}
+	cout << "\tNo satellite self-interferes." << endl;
+	return true;
+}
+
+template <typename Config>
+static inline bool check_interferer_interference(const ValidationScenario& scenario, const vector<BeamAssignment>& assignments) {
+	/**
+	 * No beam's user sees its sat within non_starlink_interference_max of an interferer. Only
+	 * interferers find_interferer_cone can't rule out by INTERFERER_CONE_COS_MARGIN are decided
+	 * exactly.
+	 * */
+	cout << "Checking no sat interferes with a non-Starlink satellite..." << endl;
+	InterfererCones cones;
+	for (const BeamAssignment& assignment : assignments) {
+		const exact_vector_3d_t& user_exact = scenario.users[assignment.user_id];
+		const exact_vector_3d_t& sat_exact = scenario.sats[assignment.sat_id];
+		vector_3d_t user_pos = position_at(scenario.scenario.users, assignment.user_id);
+		vector_3d_t sat_pos = position_at(scenario.scenario.sats, assignment.sat_id);
+		build_interferer_cones<Config>(scenario.scenario, assignment.user_id, cones);
+		double angle;
+		bool violation = find_interferer_cone<Config>(scenario.scenario, cones, assignment.user_id, user_pos, sat_pos, [&](int cone_i, float cos_angle) {
+			return cos_angle > Config::cos_non_starlink_interference_max - INTERFERER_CONE_COS_MARGIN
+				&& python_angle_within(user_exact, sat_exact, scenario.interferers[cones.interferer_ids[cone_i]],
+									   Config::non_starlink_interference_max, false, &angle);
+		});
+		if (!violation) {
+			continue;
+		}
+
+		// report the first offender in scenario order, like evaluate.py
+		for (int int_i = 0; int_i < (int) scenario.interferers.size(); int_i ++) {
+			if (python_angle_within(user_exact, sat_exact, scenario.interferers[int_i], Config::non_starlink_interference_max, false, &angle)) {
+				cout << "\tSat " << assignment.sat_id + 1 << " beam " << (int) assignment.beam_id
+					 << " interferes with non-Starlink sat " << int_i + 1 << "." << endl;
+				cout << "\t\tAngle of separation: " << format_python_float(angle) << " degrees." << endl;
+				break;
+			}
+		}
+		return false;
+	}
+	cout << "\tNo satellite interferes with a non-Starlink satellite!" << endl;
+	return true;
+}
+
+template <typename Config>
+static inline bool validate_assignments(const ValidationScenario& scenario, const vector<BeamAssignment>& assignments) {
+	/**
+	 * Run every check in evaluate.py's order, stopping at the first that fails
+	 * */
+	if (!check_user_coverage(scenario, assignments) || !check_user_visibility<Config>(scenario, assignments)
+		|| !check_self_interference<Config>(scenario, assignments)) {
+		return false;
+	}
+	if (!check_interferer_interference<Config>(scenario, assignments)) {
+		cout << "Solution contained a beam that could interfere with a non-Starlink satellite." << endl;
+		return false;
+	}
+	cout << endl << "Solution passed all checks!" << endl << endl;
+	return true;
+}
+
+static inline bool read_all(int fd, string& out_data) {
+	/**
+	 * Read fd to EOF into out_data
+	 * */
+	out_data.clear();
+	char buff[1 << 16];
+	while (true) {
+		ssize_t n = read(fd, buff, sizeof(buff));
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if (n == 0) {
+			return true;
+		}
+		out_data.append(buff, (size_t) n);
+	}
+}
+
+template <typename Config>
+static inline int validate_config(const string& scenario_path, const string& solution_path) {
+	cout << "Reading scenario file " << scenario_path << endl;
+	MappedFile scenario_file;
+	if (!map_file(scenario_path, &scenario_file)) {
+		cout << "File \'" << scenario_path << "\' does not exist" << endl;
+		return -1;
+	}
+	ValidationScenario scenario;
+	bool parsed = load_validation_scenario<Config>(scenario_file.data, scenario_file.size, scenario);
+	unmap_file(scenario_file);
+	if (!parsed) {
+		return -1;
+	}
+
+	vector<BeamAssignment> assignments;
+	if (solution_path == "") {
+		cout << "Reading solution from stdin." << endl;
+		string solution_text;
+		if (!read_all(STDIN_FILENO, solution_text)) {
+			cout << "Couldn't read solution: " << strerror(errno) << endl;
+			return -1;
+		}
+		parsed = parse_solution<Config>(solution_text.data(), solution_text.size(), scenario.scenario, assignments);
+	} else {
+		cout << "Reading solution file " << solution_path << "." << endl;
+		MappedFile solution_file;
+		if (!map_file(solution_path, &solution_file)) {
+			cout << "File \'" << solution_path << "\' does not exist" << endl;
+			return -1;
+		}
+		parsed = parse_solution<Config>(solution_file.data, solution_file.size, scenario.scenario, assignments);
+		unmap_file(solution_file);
+	}
+	if (!parsed) {
+		return -1;
+	}
+
+	return validate_assignments<Config>(scenario, assignments) ? 0 : -1;
+}
+
+inline int validate(const string& scenario_path, const string& solution_path, const string& config_name) {
+	/**
+	 * Validate the solution at solution_path, or stdin if it's "", against the scenario at
+	 * scenario_path under the constraints of the config called config_name, with no guard band (see
+	 * ExactConfig). Returns evaluate.py's exit code, 0 if the solution passes and -1 otherwise.
+	 * */
+	int exit_code = -1;
+	bool found = with_solver_config(config_name, [&](auto config) {
+		exit_code = validate_config<ExactConfig<decltype(config)>>(scenario_path, solution_path);
+	});
+	if (!found) {
+		cout << "Unknown config \'" << config_name << "\', expected one of " << solver_config_names() << endl;
+	}
+	return exit_code;
+}
+
+#endif // VALIDATE_H
@@ -0,0 +1,127 @@
+#include "vis_gpu.h"
+
+#include <cuda_runtime.h>
+
+/**
+ * CUDA implementation of gpu_vis_candidates, compiled by `make gpu`. One thread per user: a count
+ * pass sizes each user's candidate list, the host scans the counts into user_starts, and a fill
+ * pass writes the slots. Both passes are vis_gpu.h's gpu_vis_count_candidates and 
+ * gpu_vis_fill_candidates, which gpu_vis_candidates_host runs on the host too.
+ * */
+
+#define GPU_VIS_BLOCK_THREADS 128
+
+__global__ void count_candidates_kernel(GpuVisProblem problem, int* out_counts) {
+	int user_i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (user_i >= problem.num_users) {
+		return;
+	}
+	out_counts[user_i] = gpu_vis_count_candidates(problem, user_i);
+}
+
+__global__ void fill_candidates_kernel(GpuVisProblem problem, const int* user_starts, int* out_slots) {
+	int user_i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (user_i >= problem.num_users) {
+		return;
+	}
+	gpu_vis_fill_candidates(problem, user_i, out_slots + user_starts[user_i]);
+}
+
+struct GpuVisBuffers {
+	/**
+	 * Every device allocation of one gpu_vis_candidates call, freed together
+	 */
+	vector<void*> allocations;
+
+	~GpuVisBuffers() {
+		for (void* allocation : allocations) {
+			cudaFree(allocation);
+		}
+	}
+};
+
+static bool cuda_ok(cudaError_t status, const char* what, string& out_error) {
+	if (status != cudaSuccess) {
+		out_error = string(what) + ": " + cudaGetErrorString(status);
+		return false;
+	}
+	return true;
+}
+
+static bool upload_floats(GpuVisBuffers& buffers, const float* host, int count, const float** out_device, string& out_error) {
+	/**
+	 * Copies host [0, count) to a new device array
+	 * */
+	void* device = nullptr;
+	if (!cuda_ok(cudaMalloc(&device, (count > 0 ? count : 1) * sizeof(float)), "cudaMalloc", out_error)) {
+		return false;
+	}
+	buffers.allocations.push_back(device);
+	*out_device = (const float*) device;
+	return count == 0 || cuda_ok(cudaMemcpy(device, host, count * sizeof(float), cudaMemcpyHostToDevice), "cudaMemcpy", out_error);
+}
+
+bool gpu_vis_candidates(const GpuVisProblem& problem, GpuVisCandidates& out_candidates, string& out_error) {
+	int num_devices = 0;
+	if (cudaGetDeviceCount(&num_devices) != cudaSuccess || num_devices == 0) {
+		out_error = "no CUDA device";
+		return false;
+	}
+
+	GpuVisBuffers buffers;
+	GpuVisProblem device = problem;
+	bool ok = upload_floats(buffers, problem.user_xs, problem.num_users, &device.user_xs, out_error)
+		&& upload_floats(buffers, problem.user_ys, problem.num_users, &device.user_ys, out_error)
+		&& upload_floats(buffers, problem.user_zs, problem.num_users, &device.user_zs, out_error)
+		&& upload_floats(buffers, problem.sat_xs, problem.num_slots, &device.sat_xs, out_error)
+		&& upload_floats(buffers, problem.sat_ys, problem.num_slots, &device.sat_ys, out_error)
+		&& upload_floats(buffers, problem.sat_zs, problem.num_slots, &device.sat_zs, out_error)
+		&& upload_floats(buffers, problem.int_xs, problem.num_interferers, &device.int_xs, out_error)
+		&& upload_floats(buffers, problem.int_ys, problem.num_interferers, &device.int_ys, out_error)
+		&& upload_floats(buffers, problem.int_zs, problem.num_interferers, &device.int_zs, out_error);
+	if (!ok) {
+		return false;
+	}
+
+	int num_users = problem.num_users;
+	out_candidates.user_starts.assign(num_users + 1, 0);
+	out_candidates.slots.clear();
+	if (num_users == 0) {
+		return true;
+	}
+	int num_blocks = (num_users + GPU_VIS_BLOCK_THREADS - 1) / GPU_VIS_BLOCK_THREADS;
+
+	// user i's count lands in user_starts[i + 1], so an inclusive scan turns counts into starts
+	void* counts = nullptr;
+	if (!cuda_ok(cudaMalloc(&counts, num_users * sizeof(int)), "cudaMalloc", out_error)) {
+		return false;
+	}
+	buffers.allocations.push_back(counts);
+	count_candidates_kernel<<<num_blocks, GPU_VIS_BLOCK_THREADS>>>(device, (int*) counts);
+	if (!cuda_ok(cudaGetLastError(), "count_candidates_kernel", out_error)
+		|| !cuda_ok(cudaMemcpy(&out_candidates.user_starts[1], counts, num_users * sizeof(int), cudaMemcpyDeviceToHost), "cudaMemcpy", out_error)) {
+		return false;
+	}
+	for (int user_i = 0; user_i < num_users; user_i ++) {
+		out_candidates.user_starts[user_i + 1] += out_candidates.user_starts[user_i];
+	}
+	int num_candidates = out_candidates.user_starts[num_users];
+	out_candidates.slots.resize(num_candidates);
+
+	void* user_starts = nullptr;
+	void* slots = nullptr;
+	if (!cuda_ok(cudaMalloc(&user_starts, num_users * sizeof(int)), "cudaMalloc", out_error)) {
+		return false;
+	}
+	buffers.allocations.push_back(user_starts);
+	if (!cuda_ok(cudaMalloc(&slots, (num_candidates > 0 ? num_candidates : 1) * sizeof(int)), "cudaMalloc", out_error)) {
+		return false;
+	}
+	buffers.allocations.push_back(slots);
+	if (!cuda_ok(cudaMemcpy(user_starts, out_candidates.user_starts.data(), num_users * sizeof(int), cudaMemcpyHostToDevice), "cudaMemcpy", out_error)) {
+		return false;
+	}
+	fill_candidates_kernel<<<num_blocks, GPU_VIS_BLOCK_THREADS>>>(device, (const int*) user_starts, (int*) slots);
+	return cuda_ok(cudaGetLastError(), "fill_candidates_kernel", out_error)
+		&& (num_candidates == 0 || cuda_ok(cudaMemcpy(out_candidates.slots.data(), slots, num_candidates * sizeof(int), cudaMemcpyDeviceToHost), "cudaMemcpy", out_error));
+}
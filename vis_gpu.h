@@ -0,0 +1,158 @@
+#ifndef VIS_GPU_H
+#define VIS_GPU_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Optional GPU backend for the visibility stage (SolveOptions::vis_backend "gpu"). The device tests
+ * every user against every sat, brute force, with the same relaxed float visibility mask the CPU
+ * kernels use, drops sats some interferer is certain to be too close to, and compacts what's left
+ * into a CSR list of candidate slots per user. The solver then runs its exact checks on those
+ * candidates (append_candidate_sats), so the result is the same as the CPU backend's.
+ *
+ * Only `make gpu` compiles in the CUDA implementation (vis_gpu.cu, -DUSE_CUDA). Everywhere else
+ * gpu_vis_candidates fails and the solver falls back to the CPU, so the default build needs no
+ * CUDA toolkit.
+ *
+ * gpu_vis_candidates_host runs the same count and fill passes on the host, for vis_backend
+ * "gpu-host", so `make gpu-host-check` tests the prefilter and the CSR compaction against the CPU
+ * backend in the default build. Only the CUDA plumbing around them is left for `make gpu-check`.
+ * */
+
+#ifdef __CUDACC__
+#define VIS_GPU_HD __host__ __device__
+#else
+#define VIS_GPU_HD
+#endif
+
+struct GpuVisProblem {
+	/**
+	 * A visibility stage's inputs as flat SoA arrays: sats in sat_beam_list slot order, so
+	 * candidates come back as slots
+	 */
+	int num_users;
+	const float* user_xs;
+	const float* user_ys;
+	const float* user_zs;
+
+	int num_slots;
+	const float* sat_xs;
+	const float* sat_ys;
+	const float* sat_zs;
+
+	int num_interferers;
+	const float* int_xs;
+	const float* int_ys;
+	const float* int_zs;
+
+	// (cos(max_user_visible_angle) - VIS_KERNEL_COS_MARGIN)^2, see VisQuery
+	float cos_sq_visible;
+
+	// a sat whose direction from the user has a cos above this with an interferer's always violates
+	// the interferer constraint, cos(non_starlink_interference_max) + INTERFERER_CONE_COS_MARGIN
+	float cos_interferer_certain;
+};
+
+struct GpuVisCandidates {
+	/**
+	 * Candidate slots of user i, ascending, are slots[user_starts[i], user_starts[i + 1])
+	 */
+	vector<int> user_starts;
+	vector<int> slots;
+};
+
+VIS_GPU_HD static inline bool gpu_vis_is_candidate(const GpuVisProblem& problem, int user_i, int slot) {
+	/**
+	 * True if slot's sat passes the relaxed visibility mask for user_i (vis_mask_range's test) and
+	 * no interferer is certain to violate it. Runs on the device, and on the host to check it.
+	 * */
+	float ux = problem.user_xs[user_i], uy = problem.user_ys[user_i], uz = problem.user_zs[user_i];
+	float vx = problem.sat_xs[slot] - ux, vy = problem.sat_ys[slot] - uy, vz = problem.sat_zs[slot] - uz;
+	float uu = ux * ux + uy * uy + uz * uz;
+	float d = ux * vx + uy * vy + uz * vz;
+	float vv = vx * vx + vy * vy + vz * vz;
+	if (!(d > 0 && d * d > problem.cos_sq_visible * uu * vv)) {
+		return false;
+	}
+
+	float v_mag = sqrtf(vv);
+	for (int int_i = 0; int_i < problem.num_interferers; int_i ++) {
+		float ax = problem.int_xs[int_i] - ux, ay = problem.int_ys[int_i] - uy, az = problem.int_zs[int_i] - uz;
+		float a_mag = sqrtf(ax * ax + ay * ay + az * az);
+
+		// an interferer at the user's position has no direction, the exact check never flags it
+		if (a_mag == 0) {
+			continue;
+		}
+		float cos_angle = (ax * vx + ay * vy + az * vz) / (a_mag * v_mag);
+		if (cos_angle > problem.cos_interferer_certain) {
+			return false;
+		}
+	}
+	return true;
+}
+
+VIS_GPU_HD static inline int gpu_vis_count_candidates(const GpuVisProblem& problem, int user_i) {
+	/**
+	 * How many slots are candidates for user_i, the count pass
+	 * */
+	int count = 0;
+	for (int slot = 0; slot < problem.num_slots; slot ++) {
+		count += gpu_vis_is_candidate(problem, user_i, slot);
+	}
+	return count;
+}
+
+VIS_GPU_HD static inline void gpu_vis_fill_candidates(const GpuVisProblem& problem, int user_i, int* out_slots) {
+	/**
+	 * Write user_i's candidate slots, ascending, to out_slots, which has room for 
+	 * gpu_vis_count_candidates of them, the fill pass
+	 * */
+	int out_i = 0;
+	for (int slot = 0; slot < problem.num_slots; slot ++) {
+		if (gpu_vis_is_candidate(problem, user_i, slot)) {
+			out_slots[out_i ++] = slot;
+		}
+	}
+}
+
+static inline void gpu_vis_candidates_host(const GpuVisProblem& problem, GpuVisCandidates& out_candidates) {
+	/**
+	 * gpu_vis_candidates on the host, one user at a time: the count pass into user_starts[i + 1], 
+	 * the same inclusive scan, then the fill pass. Brute force over every sat, so slow, but it 
+	 * needs no device. 
+	 * */
+	int num_users = problem.num_users;
+	out_candidates.user_starts.assign(num_users + 1, 0);
+	for (int user_i = 0; user_i < num_users; user_i ++) {
+		out_candidates.user_starts[user_i + 1] = gpu_vis_count_candidates(problem, user_i);
+	}
+	for (int user_i = 0; user_i < num_users; user_i ++) {
+		out_candidates.user_starts[user_i + 1] += out_candidates.user_starts[user_i];
+	}
+	out_candidates.slots.resize(out_candidates.user_starts[num_users]);
+	for (int user_i = 0; user_i < num_users; user_i ++) {
+		gpu_vis_fill_candidates(problem, user_i, out_candidates.slots.data() + out_candidates.user_starts[user_i]);
+	}
+}
+
+#ifdef USE_CUDA
+
+// fills out_candidates on the first CUDA device, in vis_gpu.cu. Returns false, with the reason in
+// out_error, if there's no device or a CUDA call fails
+bool gpu_vis_candidates(const GpuVisProblem& problem, GpuVisCandidates& out_candidates, string& out_error);
+
+#else
+
+static inline bool gpu_vis_candidates(const GpuVisProblem&, GpuVisCandidates&, string& out_error) {
+	out_error = "built without CUDA, see make gpu";
+	return false;
+}
+
+#endif // USE_CUDA
+
+#endif // VIS_GPU_H